@@ -0,0 +1,58 @@
+/**
+ * @file aig_load_bench.cc
+ * @brief Compares AIG load time of the native binary AIGER parser against
+ * the lorina callback path, and checks that both produce the same graph.
+ *
+ * Usage: ./aig_load_bench [-runs N] design1.aig design2.aig ...
+ */
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "aig.hh"
+#include "bench.hh"
+
+namespace {
+
+bool SameGraph(const AIG& x, const AIG& y) {
+  if (x.sz_v() != y.sz_v() || x.sz_i() != y.sz_i() || x.sz_o() != y.sz_o() ||
+      x.sz_a() != y.sz_a()) {
+    return false;
+  }
+  for (int i = 0; i < x.sz_v() * 2; ++i) {
+    if (x.nodes().inputs[i] != y.nodes().inputs[i]) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int runs = 5;
+  bench::Flags flags;
+  flags.Add("-runs", &runs);
+  const std::vector<std::string> files = flags.Parse(argc, argv);
+
+  std::cout << std::setw(24) << "design" << std::setw(14) << "lorina"
+            << std::setw(14) << "binary" << std::setw(10) << "speedup"
+            << "\n";
+  for (const auto& file : files) {
+    double lorina_ms = 0, binary_ms = 0;
+    bool same = true;
+    for (int r = 0; r < runs; ++r) {
+      AIG x, y;
+      lorina_ms += bench::TimeMs([&] { x.ParseAIGER(file); });
+      binary_ms += bench::TimeMs([&] { y.ParseBinaryAIGER(file); });
+      same = same && SameGraph(x, y);
+    }
+    lorina_ms /= runs;
+    binary_ms /= runs;
+    std::cout << std::fixed << std::setprecision(3) << std::setw(24) << file
+              << std::setw(12) << lorina_ms << "ms" << std::setw(12)
+              << binary_ms << "ms" << std::setw(9) << lorina_ms / binary_ms
+              << "x" << (same ? "" : "  MISMATCH") << std::endl;
+  }
+  return 0;
+}
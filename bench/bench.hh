@@ -0,0 +1,91 @@
+/**
+ * @file bench.hh
+ * @brief Helpers shared by the benchmarks: timing and `-flag value` command
+ * lines.
+ */
+
+#ifndef BENCH_BENCH_HH_
+#define BENCH_BENCH_HH_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+/// @brief Seconds elapsed since `t0`.
+inline double Seconds(std::chrono::steady_clock::time_point t0) {
+  using std::chrono::duration;
+  return duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+/// @brief Milliseconds that `f()` takes.
+template <class F>
+double TimeMs(F&& f) {
+  auto t0 = std::chrono::steady_clock::now();
+  f();
+  auto t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+/**
+ * @brief Command line of `-name value` flags and positional arguments.
+ *
+ *   bench::Flags flags;
+ *   flags.Add("-runs", &runs);
+ *   const std::vector<std::string> files = flags.Parse(argc, argv);
+ *
+ * A flag name followed by a value sets its target, any other argument
+ * (including a flag name at the very end) is positional. Malformed numbers
+ * throw std::invalid_argument like std::stoi.
+ */
+class Flags {
+ public:
+  /// @brief Flag `name` parsed into `*value` (an integer, double or string).
+  template <class T>
+  void Add(const std::string& name, T* value) {
+    Add(name, [value](const std::string& arg) {
+      if constexpr (std::is_same_v<T, std::string>) {
+        *value = arg;
+      } else if constexpr (std::is_floating_point_v<T>) {
+        *value = std::stod(arg);
+      } else if constexpr (std::is_unsigned_v<T>) {
+        *value = std::stoull(arg);
+      } else {
+        *value = std::stoll(arg);
+      }
+    });
+  }
+
+  /// @brief Flag `name` handed to `parse`, for values that are not a number.
+  void Add(const std::string& name,
+           std::function<void(const std::string&)> parse) {
+    parsers_[name] = std::move(parse);
+  }
+
+  /// @return the positional arguments, in order
+  std::vector<std::string> Parse(int argc, char** argv) const {
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+      auto it = parsers_.find(argv[i]);
+      if (it != parsers_.end() && i + 1 < argc) {
+        it->second(argv[++i]);
+      } else {
+        positional.push_back(argv[i]);
+      }
+    }
+    return positional;
+  }
+
+ private:
+  std::map<std::string, std::function<void(const std::string&)>> parsers_;
+};
+
+}  // namespace bench
+
+#endif  // BENCH_BENCH_HH_
@@ -0,0 +1,145 @@
+/**
+ * @file cost_server_bench.cc
+ * @brief Latency per cost evaluation request, for the ways main can
+ * evaluate a netlist after changing the variant of one gate:
+ *  - spawn:    run `cost_estimator netlist.v` (a process per evaluation)
+ *  - internal: CostFunction::Compute() in-process
+ *  - set:      `set GATE CELL` to a cost server on a unix socket
+ *  - cost:     `cost` to the server (round trip + evaluation, no change)
+ *  - netlist:  `netlist PATH` to the server (full reparse)
+ * The server is forked from the benchmark and loads the library once.
+ *
+ * Usage: ./cost_server_bench [-n requests] [-cost_estimator path]
+ *        lib.json netlist.v
+ */
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench.hh"
+#include "cost_estimator.hh"
+#include "cost_server.hh"
+#include "random.hh"
+#include "utils.hh"
+
+namespace {
+
+/**
+ * @brief Times `n` calls of `request`, prints the mean, median and 99th
+ * percentile in microseconds.
+ */
+void Measure(const std::string& name, int n,
+             const std::function<void()>& request) {
+  std::vector<double> us(n);
+  for (int i = 0; i < n; ++i) {
+    const auto t0 = std::chrono::steady_clock::now();
+    request();
+    const auto t1 = std::chrono::steady_clock::now();
+    us[i] = std::chrono::duration<double, std::micro>(t1 - t0).count();
+  }
+  std::sort(us.begin(), us.end());
+  double total = 0;
+  for (double t : us) total += t;
+  std::cout << std::setw(10) << name << std::setw(8) << n << std::fixed
+            << std::setprecision(1) << std::setw(12) << total / n
+            << std::setw(12) << us[n / 2] << std::setw(12)
+            << us[std::min(n - 1, n * 99 / 100)] << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int n = 1000;
+  std::string cost_estimator = "./cost_estimator";
+  bench::Flags flags;
+  flags.Add("-n", &n);
+  flags.Add("-cost_estimator", &cost_estimator);
+  const std::vector<std::string> files = flags.Parse(argc, argv);
+  if (files.size() != 2 || n < 1) {
+    std::cerr << "Usage: ./cost_server_bench [-n requests] "
+                 "[-cost_estimator path] lib.json netlist.v\n";
+    return 1;
+  }
+  const std::string library = files[0];
+  const std::string netlist = std::filesystem::absolute(files[1]);
+
+  // diagnostics of the loads would interleave with the table
+  std::streambuf* out = std::cout.rdbuf(nullptr);
+  CostFunction f;
+  f.LoadNetlist(netlist);
+  f.LoadLibrary(library);
+
+  const std::string address =
+      "unix:/tmp/cost_server_bench-" + std::to_string(getpid()) + ".sock";
+  const pid_t server = fork();
+  if (server == 0) {
+    ServeCostSocket(f, address);
+    _exit(0);
+  }
+  CostClient client(address);
+  std::cout.rdbuf(out);
+  if (!client.ok()) {
+    std::cerr << "cannot connect to " << address << "\n";
+    return 1;
+  }
+
+  // variants of each gate's cell: the library cells with the same prefix
+  std::vector<std::vector<std::string>> variants;
+  for (const auto& gate : f.netlist().gates()) {
+    const std::string& name = gate.cell_name();
+    const std::string prefix = name.substr(0, name.rfind('_') + 1);
+    variants.emplace_back();
+    for (const auto& [cell_name, cell] : f.library().cells()) {
+      if (cell_name.rfind(prefix, 0) == 0) variants.back().push_back(cell_name);
+    }
+  }
+  Random rng(1);
+  const auto random_change = [&]() {
+    const int gate = rng.Uniform(variants.size());
+    return std::make_pair(gate, choice(variants[gate], rng));
+  };
+
+  std::cout << std::setw(10) << "request" << std::setw(8) << "n"
+            << std::setw(12) << "mean us" << std::setw(12) << "p50 us"
+            << std::setw(12) << "p99 us" << std::endl;
+  const std::string command =
+      cost_estimator + " -library " + library + " " + netlist + " > /dev/null";
+  Measure("spawn", std::max(1, n / 10),
+          [&]() { (void)std::system(command.c_str()); });
+  double sink = 0;
+  Measure("internal", n, [&]() {
+    const auto [gate, cell] = random_change();
+    f.SetGateCell(gate, cell);
+    sink += f.Compute().cost;
+  });
+  CostFunction::Result result;
+  Measure("set", n, [&]() {
+    const auto [gate, cell] = random_change();
+    client.Evaluate("set " + std::to_string(gate) + " " + cell, result);
+    sink += result.cost;
+  });
+  Measure("cost", n, [&]() {
+    client.Evaluate("cost", result);
+    sink += result.cost;
+  });
+  Measure("netlist", std::max(1, n / 10), [&]() {
+    client.Evaluate("netlist " + netlist, result);
+    sink += result.cost;
+  });
+  std::cerr << "(" << sink << ")\n";
+
+  std::string reply;
+  client.Request("quit", reply);
+  waitpid(server, nullptr, 0);
+  return 0;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file deadline_bench.cc
+ * @brief How well deadline mode (`set_time_budget`) keeps its budget: for
+ * each design and budget, runs SA to the deadline, writing the best mapping
+ * to `-out`, and prints the wall time of `Run` (final write included), the
+ * moves per second and the best cost.
+ *
+ * Usage: ./deadline_bench [-out file.v] lib.json design.aig ...
+ */
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench.hh"
+#include "simulated_annealing_mapper.hh"
+#include "temperature_schedule.hh"
+#include "utils.hh"
+
+typedef SimulatedAnnealingMapper SAM;
+
+int main(int argc, char** argv) {
+  std::string out = "deadline_bench.v";
+  bench::Flags flags;
+  flags.Add("-out", &out);
+  const std::vector<std::string> files = flags.Parse(argc, argv);
+  if (files.size() < 2) {
+    std::cerr << "Usage: ./deadline_bench [-out file.v] lib.json design.aig..\n";
+    return 1;
+  }
+
+  long long evaluations = 0;
+  const auto cost = [&evaluations](const SAM& mapper) {
+    ++evaluations;
+    return mapper.area() + mapper.power();
+  };
+  const auto add_random_gate = [](SAM& mapper, bool) {
+    mapper.ProposeAddRandomGate();
+  };
+  const auto change_aig_gate = [](SAM& mapper, bool) {
+    const int v = mapper.rng().Uniform(2 * mapper.sz_v());
+    const auto type = v & 1 ? Cell::Type::kNot : Cell::Type::kAnd;
+    const auto cell =
+        choice(mapper.library().GetCellsByType(type), mapper.rng());
+    mapper.ProposeChangeAIGNodeGate(v, cell);
+  };
+  const auto remove_random_gate = [](SAM& mapper, bool) {
+    const int g = mapper.RandomActiveGate();
+    if (g != -1) mapper.ProposeRemoveBinaryGate(g);
+  };
+  const MoveSet moves(change_aig_gate, add_random_gate, remove_random_gate);
+
+  std::cout << std::setw(24) << "design" << std::setw(10) << "budget"
+            << std::setw(10) << "wall" << std::setw(14) << "moves/s"
+            << std::setw(14) << "best" << "\n";
+  std::ostream null(nullptr);  // silence progress output
+  for (size_t f = 1; f < files.size(); ++f) {
+    SAM start(out, null);
+    start.set_seed(1);
+    start.LoadLibrary(files[0]);
+    start.Load(files[f]);
+    start.Initialize();
+
+    for (double budget : {0.1, 1.0, 5.0}) {
+      SAM mapper = start;
+      mapper.set_time_budget(budget);
+      AdaptiveSchedule schedule(1e6);
+      schedule.Calibrate(mapper.SampleUphill(cost, moves, 500));
+
+      evaluations = 0;
+      const auto t0 = std::chrono::steady_clock::now();
+      const double best = mapper.Run(schedule, cost, moves, 1, 1e6);
+      const double wall = bench::Seconds(t0);
+
+      std::cout << std::setw(24) << (budget == 0.1 ? files[f] : "")
+                << std::fixed << std::setprecision(3) << std::setw(10)
+                << budget << std::setw(10) << wall << std::scientific
+                << std::setw(14) << evaluations / wall << std::setw(14)
+                << best << std::endl;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file island_bench.cc
+ * @brief Island-model annealing when islands are lost: wall time and best
+ * cost of the coordinator with all islands healthy, and with one island that
+ * never connects, one that crashes after its assignment, and one that stalls
+ * without ever reporting.
+ *
+ * Each faulty island is dropped (after `-timeout` seconds where it has to be
+ * waited for) and the remaining ones finish the run, so every scenario should
+ * end with a finite best cost, at most about `-timeout` seconds later than
+ * the healthy run.
+ *
+ * Usage: ./island_bench [-islands N] [-epochs E] [-iterations I]
+ *        [-timeout T] [-seed S] lib.json design.aig ...
+ */
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.hh"
+#include "island.hh"
+#include "simulated_annealing_mapper.hh"
+#include "utils.hh"
+
+namespace {
+
+typedef SimulatedAnnealingMapper SAM;
+
+enum class Fault { kNone, kMissing, kCrash, kStall };
+
+double Cost(const SAM& mapper) { return mapper.area() + mapper.power(); }
+
+void AddRandomGate(SAM& mapper, bool) { mapper.ProposeAddRandomGate(); }
+
+void ChangeAIGGate(SAM& mapper, bool) {
+  const int v = mapper.rng().Uniform(2 * mapper.sz_v());
+  const auto type = v & 1 ? Cell::Type::kNot : Cell::Type::kAnd;
+  const auto cell = choice(mapper.library().GetCellsByType(type), mapper.rng());
+  mapper.ProposeChangeAIGNodeGate(v, cell);
+}
+
+/**
+ * @brief Runs the faulty island's part of the protocol, then exits.
+ */
+[[noreturn]] void RunFaultyIsland(Fault fault, const std::string& address,
+                                  double timeout) {
+  Channel coordinator(ConnectSocket(address));
+  Channel::Type type;
+  std::string payload;
+  coordinator.Receive(type, payload);
+  if (fault == Fault::kStall) {
+    // outlive the coordinator's patience, but not the bench
+    std::this_thread::sleep_for(std::chrono::duration<double>(timeout + 1));
+  }
+  _exit(0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int num_islands = 4;
+  IslandOptions options;
+  options.epochs = 5;
+  options.epoch_iterations = 20000;
+  double timeout = 2;
+  uint64_t seed = 1;
+  bench::Flags flags;
+  flags.Add("-islands", &num_islands);
+  flags.Add("-epochs", &options.epochs);
+  flags.Add("-iterations", &options.epoch_iterations);
+  flags.Add("-timeout", &timeout);
+  flags.Add("-seed", &seed);
+  const std::vector<std::string> files = flags.Parse(argc, argv);
+  if (files.size() < 2 || num_islands < 2) {
+    std::cerr << "Usage: ./island_bench [-islands N] [-epochs E] "
+                 "[-iterations I] [-timeout T] [-seed S] lib.json "
+                 "design.aig..\n";
+    return 1;
+  }
+  options.num_islands = num_islands;
+  options.connect_timeout = timeout;
+  options.report_timeout = timeout;
+
+  const std::vector<SAM::Transition> transitions = {ChangeAIGGate,
+                                                    AddRandomGate};
+  const std::string address =
+      "unix:/tmp/island_bench-" + std::to_string(getpid()) + ".sock";
+  const std::filesystem::path output =
+      std::filesystem::temp_directory_path() / "island_bench.v";
+
+  std::ostream null(nullptr);  // silence progress output
+  for (size_t f = 1; f < files.size(); ++f) {
+    SAM start("", null);
+    start.set_seed(seed);
+    start.LoadLibrary(files[0]);
+    start.Load(files[f]);
+    start.Initialize();
+
+    std::cout << files[f] << ": " << num_islands << " islands, "
+              << options.epochs << " epochs of " << options.epoch_iterations
+              << " iterations, timeout " << timeout << "s" << std::endl;
+    std::cout << std::setw(10) << "fault" << std::setw(14) << "best"
+              << std::setw(12) << "seconds" << "\n";
+    const std::pair<Fault, const char*> scenarios[] = {
+        {Fault::kNone, "none"},
+        {Fault::kMissing, "missing"},
+        {Fault::kCrash, "crash"},
+        {Fault::kStall, "stall"}};
+    for (auto [fault, name] : scenarios) {
+      const int listen_fd = ListenSocket(address);
+      if (listen_fd < 0) {
+        std::cerr << "cannot listen on " << address << std::endl;
+        return 1;
+      }
+      std::vector<pid_t> children;
+      for (int i = 0; i < num_islands; ++i) {
+        // the last island is the faulty one
+        const bool faulty = fault != Fault::kNone && i + 1 == num_islands;
+        if (faulty && fault == Fault::kMissing) continue;
+        const pid_t pid = fork();
+        if (pid == 0) {
+          close(listen_fd);
+          if (faulty) RunFaultyIsland(fault, address, timeout);
+          SAM mapper = start;
+          _exit(RunIslandWorker(mapper, address, Cost, transitions) ? 0 : 1);
+        }
+        if (pid > 0) children.push_back(pid);
+      }
+
+      SAM mapper = start;
+      auto* progress = std::cout.rdbuf(nullptr);  // the epoch lines
+      auto t0 = std::chrono::steady_clock::now();
+      const double best =
+          RunIslandCoordinator(mapper, listen_fd, options, output);
+      const double seconds = bench::Seconds(t0);
+      std::cout.rdbuf(progress);
+      std::cout.clear();
+      close(listen_fd);
+      for (pid_t pid : children) waitpid(pid, nullptr, 0);
+      std::cout << std::setw(10) << name << std::scientific
+                << std::setprecision(4) << std::setw(14) << best << std::fixed
+                << std::setprecision(3) << std::setw(12) << seconds
+                << std::endl;
+    }
+    unlink(address.substr(5).c_str());
+    std::filesystem::remove(output);
+  }
+  return 0;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file mapper_init_bench.cc
+ * @brief Times `AIG::Load` and `IterativeTechnologyMapper::Initialize`.
+ * Build it on two commits to compare node layouts. The last column is the
+ * startup (library + design + primitives) from a warm snapshot.
+ *
+ * Usage: ./mapper_init_bench [-runs N] lib1.json design1.aig design2.aig ...
+ */
+
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench.hh"
+#include "iterative_technology_mapper.hh"
+
+int main(int argc, char** argv) {
+  int runs = 5;
+  bench::Flags flags;
+  flags.Add("-runs", &runs);
+  const std::vector<std::string> files = flags.Parse(argc, argv);
+  if (files.size() < 2) {
+    std::cerr << "Usage: ./mapper_init_bench [-runs N] lib.json design.aig..\n";
+    return 1;
+  }
+
+  std::cout << std::setw(24) << "design" << std::setw(14) << "load"
+            << std::setw(14) << "initialize" << std::setw(14) << "snapshot"
+            << "\n";
+  for (size_t f = 1; f < files.size(); ++f) {
+    double load_ms = 0, init_ms = 0, cached_ms = 0;
+    for (int r = 0; r < runs; ++r) {
+      IterativeTechnologyMapper mapper;
+      mapper.LoadLibrary(files[0]);
+      load_ms += bench::TimeMs([&] { mapper.Load(files[f]); });
+      init_ms += bench::TimeMs([&] { mapper.Initialize(); });
+    }
+    const std::string snapshot = files[f] + ".snapshot";
+    std::filesystem::remove(snapshot);
+    IterativeTechnologyMapper().LoadCached(files[f], files[0], snapshot);
+    for (int r = 0; r < runs; ++r) {
+      IterativeTechnologyMapper mapper;
+      cached_ms += bench::TimeMs([&] {
+        mapper.LoadCached(files[f], files[0], snapshot);
+        mapper.Initialize();
+      });
+    }
+    std::cout << std::fixed << std::setprecision(3) << std::setw(24)
+              << files[f] << std::setw(12) << load_ms / runs << "ms"
+              << std::setw(12) << init_ms / runs << "ms" << std::setw(12)
+              << cached_ms / runs << "ms" << std::endl;
+  }
+  return 0;
+}
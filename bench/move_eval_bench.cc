@@ -0,0 +1,113 @@
+/**
+ * @file move_eval_bench.cc
+ * @brief Measures how many rejected SA moves per second the mapper can
+ * evaluate, for three ways of trying a move and throwing it away:
+ *  - inverse: apply it, then apply the inverse update (the original SA loop)
+ *  - journal: apply it in a transaction, then Rollback()
+ *  - delta:   propose it (read-only cascade walk), then Rollback()
+ *
+ * Usage: ./move_eval_bench [-moves N] [-warmup N] lib.json design.aig ...
+ */
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench.hh"
+#include "iterative_technology_mapper.hh"
+#include "utils.hh"
+
+namespace {
+
+enum class Mode { kInverse, kJournal, kDelta };
+
+/**
+ * @brief Tries and rejects `moves` moves, alternating between adding a
+ * random gate and changing the cell of a random AIG node.
+ *
+ * @return moves per second
+ */
+double Evaluate(IterativeTechnologyMapper& mapper, Mode mode, int moves) {
+  mapper.set_seed(1);  // same moves for every mode
+  double sink = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int it = 0; it < moves; ++it) {
+    if (it & 1) {
+      const int v = mapper.rng().Uniform(2 * mapper.sz_v());
+      const auto type = v & 1 ? Cell::Type::kNot : Cell::Type::kAnd;
+      const auto cell =
+          choice(mapper.library().GetCellsByType(type), mapper.rng());
+      const auto old_cell = mapper.aig_nodes()[v].cell;
+      if (mode == Mode::kInverse) {
+        mapper.ChangeAIGNodeGate(v, cell);
+        sink += mapper.area();
+        mapper.ChangeAIGNodeGate(v, old_cell);
+      } else {
+        mapper.Begin();
+        if (mode == Mode::kJournal) {
+          mapper.ChangeAIGNodeGate(v, cell);
+        } else {
+          mapper.ProposeChangeAIGNodeGate(v, cell);
+        }
+        sink += mapper.area();
+        mapper.Rollback();
+      }
+    } else {
+      if (mode == Mode::kInverse) {
+        mapper.AddRandomGate();
+        sink += mapper.area();
+        mapper.UndoGateAdd();
+      } else {
+        mapper.Begin();
+        if (mode == Mode::kJournal) {
+          mapper.AddRandomGate();
+        } else {
+          mapper.ProposeAddRandomGate();
+        }
+        sink += mapper.area();
+        mapper.Rollback();
+      }
+    }
+  }
+  const double seconds = bench::Seconds(t0);
+  if (sink == 0) std::cerr << "";  // keep the loop alive
+  return moves / seconds;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int moves = 200000;
+  int warmup = 2000;
+  bench::Flags flags;
+  flags.Add("-moves", &moves);
+  flags.Add("-warmup", &warmup);
+  const std::vector<std::string> files = flags.Parse(argc, argv);
+  if (files.size() < 2) {
+    std::cerr << "Usage: ./move_eval_bench [-moves N] [-warmup N] lib.json "
+                 "design.aig..\n";
+    return 1;
+  }
+
+  std::cout << std::setw(24) << "design" << std::setw(14) << "inverse"
+            << std::setw(14) << "journal" << std::setw(14) << "delta"
+            << "  (moves/s)\n";
+  for (size_t f = 1; f < files.size(); ++f) {
+    IterativeTechnologyMapper mapper;
+    mapper.LoadLibrary(files[0]);
+    mapper.Load(files[f]);
+    mapper.Initialize();
+    for (int i = 0; i < warmup; ++i) mapper.AddRandomGate();  // accepted
+
+    const double inverse = Evaluate(mapper, Mode::kInverse, moves);
+    const double journal = Evaluate(mapper, Mode::kJournal, moves);
+    const double delta = Evaluate(mapper, Mode::kDelta, moves);
+    std::cout << std::setw(24) << files[f] << std::scientific
+              << std::setprecision(3) << std::setw(14) << inverse
+              << std::setw(14) << journal << std::setw(14) << delta
+              << std::endl;
+  }
+  return 0;
+}
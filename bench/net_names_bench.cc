@@ -0,0 +1,68 @@
+/**
+ * @file net_names_bench.cc
+ * @brief Heap usage and time of building the net name table for a large
+ * synthetic design: one std::string per literal (the old layout) against
+ * `AIG::NetNames`, which only stores the I/O names.
+ *
+ * Usage: ./net_names_bench [-vars V] [-io N]
+ */
+
+#include <malloc.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "aig.hh"
+#include "bench.hh"
+
+namespace {
+
+size_t HeapInUse() {
+  auto info = mallinfo2();
+  return info.uordblks + info.hblkhd;  // small blocks + mmap-ed blocks
+}
+
+struct Names : AIG {
+  static NetNames Build(int io) {
+    NetNames names;
+    for (int i = 0; i < io; ++i) names.Set(i * 2, "port_" + std::to_string(i));
+    return names;
+  }
+};
+
+template <class F>
+void Report(const std::string& label, F&& build) {
+  const size_t before = HeapInUse();
+  auto t0 = std::chrono::steady_clock::now();
+  auto names = build();
+  auto t1 = std::chrono::steady_clock::now();
+  const size_t after = HeapInUse();
+  std::cout << std::setw(12) << label << std::fixed << std::setprecision(1)
+            << std::setw(12) << (after - before) / 1048576.0 << "MiB"
+            << std::setprecision(3) << std::setw(12)
+            << std::chrono::duration<double, std::milli>(t1 - t0).count()
+            << "ms" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int vars = 5000000, io = 2000;
+  bench::Flags flags;
+  flags.Add("-vars", &vars);
+  flags.Add("-io", &io);
+  flags.Parse(argc, argv);
+  std::cout << "literals=" << 2LL * vars << " io=" << io << "\n";
+
+  Report("per-literal", [&] {
+    std::vector<std::string> names(vars * 2, "v");
+    for (int i = 0; i < vars * 2; ++i) names[i] += std::to_string(i);
+    for (int i = 0; i < io; ++i) names[i * 2] = "port_" + std::to_string(i);
+    return names;
+  });
+  Report("interned", [&] { return Names::Build(io); });
+  return 0;
+}
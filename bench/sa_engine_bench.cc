@@ -0,0 +1,112 @@
+/**
+ * @file sa_engine_bench.cc
+ * @brief SA iterations per second with `std::function` policies (the
+ * original `Run` overload) vs. compile-time policies (`Run` with a
+ * `MoveSet`). Both runs start from the same mapping and seed, so they must
+ * also end at the same best cost. Reports the best of `-repeat` runs.
+ *
+ * Usage: ./sa_engine_bench [-iterations N] [-repeat N] lib.json design.aig ...
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench.hh"
+#include "simulated_annealing_mapper.hh"
+#include "utils.hh"
+
+namespace {
+
+typedef SimulatedAnnealingMapper SAM;
+
+struct Result {
+  double best;
+  double iterations_per_second;
+};
+
+template <class F>
+Result Measure(const SAM& start, int iterations, int repeat, F run) {
+  Result result = {0, 0};
+  for (int r = 0; r < repeat; ++r) {
+    SAM mapper = start;
+    auto t0 = std::chrono::steady_clock::now();
+    result.best = run(mapper);
+    const double seconds = bench::Seconds(t0);
+    result.iterations_per_second =
+        std::max(result.iterations_per_second, iterations / seconds);
+  }
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int iterations = 1000000;
+  int repeat = 3;
+  bench::Flags flags;
+  flags.Add("-iterations", &iterations);
+  flags.Add("-repeat", &repeat);
+  const std::vector<std::string> files = flags.Parse(argc, argv);
+  if (files.size() < 2) {
+    std::cerr << "Usage: ./sa_engine_bench [-iterations N] [-repeat N] "
+                 "lib.json design.aig..\n";
+    return 1;
+  }
+
+  const auto schedule = [iterations](double t1, int i) {
+    return t1 * std::pow(1e-3, (double)i / iterations);
+  };
+  const auto cost = [](const SAM& mapper) {
+    return mapper.area() + mapper.power();
+  };
+  const auto add_random_gate = [](SAM& mapper, bool) {
+    mapper.ProposeAddRandomGate();
+  };
+  const auto change_aig_gate = [](SAM& mapper, bool) {
+    const int v = mapper.rng().Uniform(2 * mapper.sz_v());
+    const auto type = v & 1 ? Cell::Type::kNot : Cell::Type::kAnd;
+    const auto cell =
+        choice(mapper.library().GetCellsByType(type), mapper.rng());
+    mapper.ProposeChangeAIGNodeGate(v, cell);
+  };
+
+  std::cout << std::setw(24) << "design" << std::setw(14) << "function"
+            << std::setw(14) << "template" << std::setw(10) << "speedup"
+            << "  (iterations/s)\n";
+  std::ostream null(nullptr);  // silence progress output
+  for (size_t f = 1; f < files.size(); ++f) {
+    SAM start("", null);
+    start.set_seed(1);
+    start.LoadLibrary(files[0]);
+    start.Load(files[f]);
+    start.Initialize();
+
+    const Result function =
+        Measure(start, iterations, repeat, [&](SAM& mapper) {
+          return mapper.Run(SAM::TemperatureSchedule(schedule),
+                            SAM::CostEstimator(cost),
+                            {change_aig_gate, add_random_gate}, 1, iterations);
+        });
+    const Result templated =
+        Measure(start, iterations, repeat, [&](SAM& mapper) {
+          return mapper.Run(schedule, cost,
+                            MoveSet(change_aig_gate, add_random_gate), 1,
+                            iterations);
+        });
+    std::cout << std::setw(24) << files[f] << std::scientific
+              << std::setprecision(3) << std::setw(14)
+              << function.iterations_per_second << std::setw(14)
+              << templated.iterations_per_second << std::fixed
+              << std::setw(10)
+              << templated.iterations_per_second /
+                     function.iterations_per_second;
+    if (function.best != templated.best) std::cout << "  (results differ!)";
+    std::cout << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file schedule_bench.cc
+ * @brief Compares SA temperature schedules on the same designs, moves and
+ * seed:
+ *  - harmonic:  t1 * 0.2 / (i / 10), the original sa schedule (with the
+ *               divide by zero for i < 10 clamped)
+ *  - geometric: calibrated T0 cooled geometrically to T0 / 1000
+ *  - adaptive:  AdaptiveSchedule, calibrated on the same warm-up
+ * For each, prints the best cost after `-iterations` iterations, and how many
+ * iterations it took to reach the best cost of the harmonic schedule.
+ *
+ * Usage: ./schedule_bench [-iterations N] [-warmup N] [-seed S]
+ *        lib.json design.aig ...
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench.hh"
+#include "simulated_annealing_mapper.hh"
+#include "temperature_schedule.hh"
+#include "utils.hh"
+
+namespace {
+
+typedef SimulatedAnnealingMapper SAM;
+
+struct Result {
+  double best;     // after all iterations
+  long long hits;  // iterations to reach the target, -1 if never
+};
+
+/**
+ * @brief Runs `schedule` from `start` twice: once in full for the best cost,
+ * once stopping at `target` to count iterations.
+ */
+template <class Schedule, class Moves>
+Result Measure(const SAM& start, Schedule schedule, const Moves& moves,
+               double t1, int iterations, double target) {
+  long long evaluations = 0;
+  const auto cost = [&evaluations](const SAM& mapper) {
+    ++evaluations;
+    return mapper.area() + mapper.power();
+  };
+  Result result;
+  {
+    SAM mapper = start;
+    result.best = mapper.Run(schedule, cost, moves, t1, iterations);
+  }
+  SAM mapper = start;
+  mapper.set_target_cost(target);
+  evaluations = 0;
+  const double best = mapper.Run(schedule, cost, moves, t1, iterations);
+  result.hits = best <= target ? evaluations - 1 : -1;  // minus the initial
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int iterations = 200000;
+  int warmup = 500;
+  uint64_t seed = 1;
+  bench::Flags flags;
+  flags.Add("-iterations", &iterations);
+  flags.Add("-warmup", &warmup);
+  flags.Add("-seed", &seed);
+  const std::vector<std::string> files = flags.Parse(argc, argv);
+  if (files.size() < 2) {
+    std::cerr << "Usage: ./schedule_bench [-iterations N] [-warmup N] "
+                 "[-seed S] lib.json design.aig..\n";
+    return 1;
+  }
+
+  const auto add_random_gate = [](SAM& mapper, bool) {
+    mapper.ProposeAddRandomGate();
+  };
+  const auto change_aig_gate = [](SAM& mapper, bool) {
+    const int v = mapper.rng().Uniform(2 * mapper.sz_v());
+    const auto type = v & 1 ? Cell::Type::kNot : Cell::Type::kAnd;
+    const auto cell =
+        choice(mapper.library().GetCellsByType(type), mapper.rng());
+    mapper.ProposeChangeAIGNodeGate(v, cell);
+  };
+  const auto remove_random_gate = [](SAM& mapper, bool) {
+    const int g = mapper.RandomActiveGate();
+    if (g != -1) mapper.ProposeRemoveBinaryGate(g);
+  };
+  const MoveSet moves(change_aig_gate, add_random_gate, remove_random_gate);
+  const auto cost = [](const SAM& mapper) {
+    return mapper.area() + mapper.power();
+  };
+
+  std::cout << std::setw(24) << "design" << std::setw(11) << "schedule"
+            << std::setw(14) << "best" << std::setw(14) << "iterations"
+            << "  (to reach the harmonic best)\n";
+  std::ostream null(nullptr);  // silence progress output
+  for (size_t f = 1; f < files.size(); ++f) {
+    SAM start("", null);
+    start.set_seed(seed);
+    start.LoadLibrary(files[0]);
+    start.Load(files[f]);
+    start.Initialize();
+
+    SAM probe = start;  // warm-up draws shouldn't shift the runs
+    const std::vector<double> uphill = probe.SampleUphill(cost, moves, warmup);
+    const double t0 = InitialTemperature(uphill, 0.8);
+
+    const auto harmonic = [](double t1, int i) {
+      return t1 * 0.2 / std::max(i / 10, 1);
+    };
+    const auto geometric = [iterations](double t1, int i) {
+      return t1 * std::pow(1e-3, (double)i / iterations);
+    };
+    AdaptiveSchedule adaptive(iterations);
+    adaptive.Calibrate(uphill);
+
+    SAM reference = start;
+    const double target =
+        reference.Run(harmonic, cost, moves, 1, iterations);
+    const Result results[] = {
+        Measure(start, harmonic, moves, 1, iterations, target),
+        Measure(start, geometric, moves, t0, iterations, target),
+        Measure(start, adaptive, moves, t0, iterations, target)};
+    const char* names[] = {"harmonic", "geometric", "adaptive"};
+    for (int k = 0; k < 3; ++k) {
+      std::cout << std::setw(24) << (k ? "" : files[f]) << std::setw(11)
+                << names[k] << std::scientific << std::setprecision(4)
+                << std::setw(14) << results[k].best << std::setw(14);
+      if (results[k].hits >= 0) {
+        std::cout << results[k].hits << std::endl;
+      } else {
+        std::cout << "-" << std::endl;
+      }
+    }
+  }
+  return 0;
+}
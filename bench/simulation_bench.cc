@@ -0,0 +1,52 @@
+/**
+ * @file simulation_bench.cc
+ * @brief Measures random-simulation throughput of
+ * `AIG::SimulateSetProbability` in patterns x nodes per second, and how far
+ * the simulated set probabilities are from the analytic ones.
+ *
+ * Usage: ./simulation_bench [-patterns N] [-threads T] design1.aig ...
+ */
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "aig.hh"
+#include "bench.hh"
+
+int main(int argc, char** argv) {
+  long long patterns = 1 << 16;
+  int threads = 1;
+  bench::Flags flags;
+  flags.Add("-patterns", &patterns);
+  flags.Add("-threads", &threads);
+  const std::vector<std::string> files = flags.Parse(argc, argv);
+
+  std::cout << std::setw(24) << "design" << std::setw(12) << "time"
+            << std::setw(16) << "pattern*node/s" << std::setw(14)
+            << "mean |dp|" << "\n";
+  for (const auto& file : files) {
+    AIG aig;
+    aig.set_num_threads(threads);
+    aig.Load(file);
+    const std::vector<double> analytic = aig.nodes().set_prob;
+
+    auto t0 = std::chrono::steady_clock::now();
+    aig.SimulateSetProbability(patterns);
+    double s = bench::Seconds(t0);
+
+    double diff = 0;
+    for (size_t i = 0; i < analytic.size(); ++i) {
+      diff += std::fabs(analytic[i] - aig.nodes().set_prob[i]);
+    }
+    std::cout << std::setw(24) << file << std::fixed << std::setprecision(3)
+              << std::setw(10) << s * 1e3 << "ms" << std::scientific
+              << std::setprecision(3) << std::setw(16)
+              << patterns * (double)aig.sz_a() / s << std::setw(14)
+              << diff / analytic.size() << std::endl;
+  }
+  return 0;
+}
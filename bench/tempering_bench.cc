@@ -0,0 +1,131 @@
+/**
+ * @file tempering_bench.cc
+ * @brief Time-to-target-cost of parallel tempering vs. the serial SA `Run`.
+ *
+ * For each design, a serial run with geometric cooling sets the target: the
+ * cost after closing `-fraction` of the gap between the initial cost and its
+ * best cost. Then the serial run and parallel tempering with each replica
+ * count are timed until they first reach that target, all from the same
+ * starting mapping.
+ *
+ * Usage: ./tempering_bench [-iterations N] [-replicas 2,4,8] [-swap K]
+ *        [-fraction F] [-seed S] lib.json design.aig ...
+ */
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench.hh"
+#include "simulated_annealing_mapper.hh"
+#include "utils.hh"
+
+namespace {
+
+typedef SimulatedAnnealingMapper SAM;
+
+constexpr double kMinTemperature = 1e-3;
+constexpr double kMaxTemperature = 1;
+
+double Cost(const SAM& mapper) { return mapper.area() + mapper.power(); }
+
+void AddRandomGate(SAM& mapper, bool) { mapper.ProposeAddRandomGate(); }
+
+void ChangeAIGGate(SAM& mapper, bool) {
+  const int v = mapper.rng().Uniform(2 * mapper.sz_v());
+  const auto type = v & 1 ? Cell::Type::kNot : Cell::Type::kAnd;
+  const auto cell = choice(mapper.library().GetCellsByType(type), mapper.rng());
+  mapper.ProposeChangeAIGNodeGate(v, cell);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int iterations = 200000;
+  int swap_interval = 100;
+  double fraction = 0.99;
+  uint64_t seed = 1;
+  std::vector<int> replica_counts = {2, 4, 8};
+  bench::Flags flags;
+  flags.Add("-iterations", &iterations);
+  flags.Add("-swap", &swap_interval);
+  flags.Add("-fraction", &fraction);
+  flags.Add("-seed", &seed);
+  flags.Add("-replicas", [&](const std::string& list) {
+    replica_counts.clear();
+    std::stringstream ss(list);
+    for (std::string n; std::getline(ss, n, ',');) {
+      replica_counts.push_back(std::stoi(n));
+    }
+  });
+  const std::vector<std::string> files = flags.Parse(argc, argv);
+  if (files.size() < 2) {
+    std::cerr << "Usage: ./tempering_bench [-iterations N] [-replicas 2,4,8] "
+                 "[-swap K] [-fraction F] [-seed S] lib.json design.aig..\n";
+    return 1;
+  }
+
+  const std::vector<SAM::Transition> transitions = {ChangeAIGGate,
+                                                    AddRandomGate};
+  const SAM::TemperatureSchedule cooling = [&](double t1, int i) {
+    return t1 * std::pow(kMinTemperature / t1, (double)i / iterations);
+  };
+
+  std::ostream null(nullptr);  // silence progress output
+  for (size_t f = 1; f < files.size(); ++f) {
+    SAM start("", null);
+    start.set_seed(seed);
+    start.LoadLibrary(files[0]);
+    start.Load(files[f]);
+    start.Initialize();
+    const double initial = Cost(start);
+
+    SAM probe = start;
+    const double serial_best =
+        probe.Run(cooling, Cost, transitions, kMaxTemperature, iterations);
+    const double target = initial - fraction * (initial - serial_best);
+
+    std::cout << files[f] << std::scientific << std::setprecision(4)
+              << ": initial=" << initial << " serial best=" << serial_best
+              << " target=" << target << std::endl;
+    std::cout << std::setw(10) << "replicas" << std::setw(14) << "best"
+              << std::setw(12) << "seconds" << std::setw(10) << "speedup"
+              << "\n";
+
+    double serial_seconds = 0;
+    {
+      SAM mapper = start;
+      mapper.set_target_cost(target);
+      auto t0 = std::chrono::steady_clock::now();
+      const double best = mapper.Run(cooling, Cost, transitions,
+                                     kMaxTemperature, iterations);
+      serial_seconds = bench::Seconds(t0);
+      std::cout << std::setw(10) << "serial" << std::scientific
+                << std::setw(14) << best << std::fixed << std::setprecision(3)
+                << std::setw(12) << serial_seconds << std::setw(10) << 1.0
+                << std::endl;
+    }
+    for (int replicas : replica_counts) {
+      SAM mapper = start;
+      mapper.set_target_cost(target);
+      auto t0 = std::chrono::steady_clock::now();
+      const double best = mapper.RunParallelTempering(
+          Cost, transitions, kMinTemperature, kMaxTemperature, iterations,
+          replicas, swap_interval);
+      const double seconds = bench::Seconds(t0);
+      std::cout << std::setw(10) << replicas << std::scientific
+                << std::setprecision(4) << std::setw(14) << best << std::fixed
+                << std::setprecision(3) << std::setw(12) << seconds;
+      if (best <= target) {
+        std::cout << std::setw(10) << serial_seconds / seconds << std::endl;
+      } else {
+        std::cout << std::setw(10) << "missed" << std::endl;
+      }
+    }
+  }
+  return 0;
+}
@@ -2,12 +2,26 @@
 
 #include <cmath>
 #include <iostream>
+#include <stdexcept>
+#include <utility>
 
 #include "timing.hh"
 
 void CostFunction::LoadNetlist(const std::filesystem::path &file) {
   StartClock();
-  netlist_.Load(file);
+  // into a new netlist first, so that the current one stays if this throws
+  Netlist netlist;
+  netlist.Load(file);
+  if (netlist.num_gates() == 0) {
+    throw std::runtime_error("no gates in " + file.string());
+  }
+  if (!library_.cells().empty()) {
+    netlist.LoadLibrary(library_);
+    if (simulation_patterns_ > 0) {
+      netlist.SimulateSwitching(simulation_patterns_);
+    }
+  }
+  netlist_ = std::move(netlist);
   EndClockPrint("<load:netlist>");
 }
 
@@ -15,55 +29,48 @@ void CostFunction::LoadLibrary(const std::filesystem::path &file) {
   StartClock();
   library_.Load(file);
   netlist_.LoadLibrary(library_);
+  if (simulation_patterns_ > 0) {
+    netlist_.SimulateSwitching(simulation_patterns_);
+  }
   EndClockPrint("<load:library>");
 }
 
 double CostFunction::Evaluate() {
   StartClock();
-  StartClock();
-  double area = 0, power = 0;
-  for (auto [cell_name, cells_used] : netlist_.cell_count()) {
-    const auto &cell = library_.cells().at(cell_name);
-    area += cell.area() * cells_used;
-    power += cell.leakage_power() * cells_used;
-  }
+  const Result result = Compute();
   auto [c0, a0, p0] = netlist_.GetConstraints();
-  EndClockPrint("<eval:[area power]>");
-
-  StartClock();
-  double dynamic_power = netlist_.ComputeDynamicPower(library_);
-  EndClockPrint("<eval:[dyn_power]>");
+  EndClockPrint("<eval:costfunc>");
 
   std::cout << std::fixed << std::setprecision(26);
-  std::cout << "area      = " << area << "\n"
-            << "power     = " << power << "\n"
-            << "dyn_power = " << dynamic_power << std::endl;
+  std::cout << "area      = " << result.area << "\n"
+            << "power     = " << result.power << "\n"
+            << "dyn_power = " << result.dynamic_power << std::endl;
 
-  
   std::cout << "clock_period     = " << c0 << "\n";
   std::cout << "area_constraint  = " << a0 << "\n";
   std::cout << "power_constraint = " << p0 << "\n";
-
-  double cost = area * (power + dynamic_power);
-  if (area >= a0 || (dynamic_power + p0 >= 0 && power >= p0)) {
-    cost += 2e7;
-  }
-  EndClockPrint("<eval:costfunc>");
-  return std::pow(cost, 0.5);
+  return result.cost;
 }
 
-int main(const int argc, const char **argv) {
-  if (argc < 2) {
-    std::cerr << "Usage: ./sample_parser verilog_file\n";
-    return EXIT_FAILURE;
+CostFunction::Result CostFunction::Compute() const {
+  Result result{0, 0, 0, 0};
+  for (auto [cell_name, cells_used] : netlist_.cell_count()) {
+    const auto &cell = library_.cells().at(cell_name);
+    result.area += cell.area() * cells_used;
+    result.power += cell.leakage_power() * cells_used;
   }
+  result.dynamic_power = netlist_.ComputeDynamicPower(library_);
 
-  if (std::filesystem::exists(argv[1])) {
-    CostFunction f;
-    f.LoadNetlist(argv[1]);
-    f.LoadLibrary("lib1.json");
-    double cost = f.Evaluate();
-    std::cout << "cost = " << cost << std::endl;
+  auto [c0, a0, p0] = netlist_.GetConstraints();
+  double cost = result.area * (result.power + result.dynamic_power);
+  if (result.area >= a0 ||
+      (result.dynamic_power + p0 >= 0 && result.power >= p0)) {
+    cost += 2e7;
   }
-  return EXIT_SUCCESS;
+  result.cost = std::pow(cost, 0.5);
+  return result;
+}
+
+void CostFunction::SetGateCell(int gate, const std::string &cell_name) {
+  netlist_.SetCell(gate, library_.cells().at(cell_name));
 }
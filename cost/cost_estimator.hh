@@ -8,9 +8,17 @@
 
 class CostFunction {
  public:
+  /// @brief The quantities the cost is made of.
+  struct Result {
+    double area, power, dynamic_power, cost;
+  };
+
   virtual ~CostFunction() {}
 
-  /// @brief Loads the netlist at the path into the cost function.
+  /// @brief Loads the netlist at the path into the cost function, replacing
+  ///        the previous one, which is kept if loading throws (e.g. for a
+  ///        file without gates). Can be called before or after
+  ///        LoadLibrary().
   /// @param file
   void LoadNetlist(const std::filesystem::__cxx11::path &file);
 
@@ -23,9 +31,29 @@ class CostFunction {
   /// library.
   double Evaluate();
 
+  /// @brief Same as Evaluate(), without printing anything.
+  Result Compute() const;
+
+  /// @brief Changes the cell of the `gate`-th gate of the netlist (in file
+  /// order) to the library cell `cell_name`, for evaluating netlists that
+  /// differ only in gate variants without loading them again.
+  void SetGateCell(int gate, const std::string &cell_name);
+
+  /// @brief With `num_patterns` > 0, the dynamic power uses switching rates
+  ///        simulated on that many random patterns when the netlist and the
+  ///        library are loaded, instead of the analytic ones the reference
+  ///        cost function uses. Call before loading.
+  void set_simulation_patterns(long long num_patterns) {
+    simulation_patterns_ = num_patterns;
+  }
+
+  const Library &library() const { return library_; }
+  const Netlist &netlist() const { return netlist_; }
+
  private:
   Library library_;
   Netlist netlist_;
+  long long simulation_patterns_ = 0;
 };
 
 #endif  // COST_VERILOG_PARSER_HH
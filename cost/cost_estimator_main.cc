@@ -0,0 +1,55 @@
+#include <iostream>
+#include <string>
+
+#include "cost_estimator.hh"
+#include "cost_server.hh"
+
+int main(const int argc, const char **argv) {
+  bool server = false;
+  std::string socket_address;  // serves stdin if empty
+  std::string library = "lib1.json";
+  std::string netlist;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "-server") {
+      server = true;
+    } else if (arg == "-socket" && i + 1 < argc) {
+      socket_address = argv[++i];
+    } else if (arg == "-library" && i + 1 < argc) {
+      library = argv[++i];
+    } else {
+      netlist = arg;
+    }
+  }
+
+  if (server) {
+    // replies own stdout, diagnostics go to stderr
+    std::ostream replies(std::cout.rdbuf());
+    if (socket_address.empty()) std::cout.rdbuf(std::cerr.rdbuf());
+    CostFunction f;
+    f.LoadLibrary(library);
+    if (socket_address.empty()) {
+      ServeCostRequests(f, std::cin, replies);
+    } else if (!ServeCostSocket(f, socket_address)) {
+      std::cerr << "cannot listen on " << socket_address << "\n";
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  if (netlist.empty()) {
+    std::cerr << "Usage: ./sample_parser verilog_file\n"
+              << "       ./sample_parser -server [-socket unix:PATH]"
+              << " [-library lib.json]\n";
+    return EXIT_FAILURE;
+  }
+
+  if (std::filesystem::exists(netlist)) {
+    CostFunction f;
+    f.LoadNetlist(netlist);
+    f.LoadLibrary(library);
+    double cost = f.Evaluate();
+    std::cout << "cost = " << cost << std::endl;
+  }
+  return EXIT_SUCCESS;
+}
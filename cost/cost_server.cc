@@ -0,0 +1,143 @@
+#include "cost_server.hh"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "socket.hh"
+
+namespace {
+
+/// @brief Next line from `fd`, without the newline. `buffer` keeps what was
+///        read past it.
+/// @return false if the peer is gone
+bool ReadLine(int fd, std::string &buffer, std::string &line) {
+  size_t end;
+  while ((end = buffer.find('\n')) == std::string::npos) {
+    char chunk[4096];
+    const ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    buffer.append(chunk, n);
+  }
+  line = buffer.substr(0, end);
+  buffer.erase(0, end + 1);
+  return true;
+}
+
+/// @brief Gate type of a cell, the name without the variant: "nand" for
+///        "nand_3".
+std::string CellType(const std::string &cell) {
+  return cell.substr(0, cell.rfind('_'));
+}
+
+std::string FormatResult(const CostFunction::Result &result) {
+  char reply[128];
+  std::snprintf(reply, sizeof(reply), "%.17g %.17g %.17g %.17g", result.area,
+                result.power, result.dynamic_power, result.cost);
+  return reply;
+}
+
+}  // namespace
+
+std::string HandleCostRequest(CostFunction &f, const std::string &request,
+                              bool &quit) {
+  std::istringstream in(request);
+  std::string command;
+  in >> command;
+  quit = command == "quit";
+  if (quit) return "";
+
+  try {
+    if (command == "netlist") {
+      std::string path;
+      in >> path;
+      if (!std::filesystem::exists(path)) return "error no such file " + path;
+      f.LoadNetlist(path);
+    } else if (command == "gates") {
+      return std::to_string(f.netlist().num_gates());
+    } else if (command == "set") {
+      // validate everything first, so that an error changes nothing
+      std::vector<std::pair<int, std::string>> changes;
+      int gate;
+      std::string cell;
+      while (in >> gate) {
+        if (!(in >> cell)) return "error malformed set";
+        if (gate < 0 || gate >= f.netlist().num_gates()) {
+          return "error no gate " + std::to_string(gate);
+        }
+        if (!f.library().cells().count(cell)) return "error no cell " + cell;
+        const std::string &current = f.netlist().gates()[gate].cell_name();
+        if (CellType(cell) != CellType(current)) {
+          return "error " + cell + " is not a variant of " + current;
+        }
+        changes.emplace_back(gate, cell);
+      }
+      if (!in.eof()) return "error malformed set";
+      for (auto &[gate, cell] : changes) f.SetGateCell(gate, cell);
+    } else if (command != "cost") {
+      return "error unknown request " + command;
+    }
+    return FormatResult(f.Compute());
+  } catch (const std::exception &e) {
+    return std::string("error ") + e.what();
+  }
+}
+
+void ServeCostRequests(CostFunction &f, std::istream &in, std::ostream &out) {
+  std::string request;
+  bool quit = false;
+  while (!quit && std::getline(in, request)) {
+    const std::string reply = HandleCostRequest(f, request, quit);
+    if (!quit) out << reply << std::endl;
+  }
+}
+
+bool ServeCostSocket(CostFunction &f, const std::string &address) {
+  const int listen_fd = ListenSocket(address);
+  if (listen_fd < 0) return false;
+  bool quit = false;
+  while (!quit) {
+    const int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    std::string buffer, request;
+    while (!quit && ReadLine(fd, buffer, request)) {
+      const std::string reply = HandleCostRequest(f, request, quit) + "\n";
+      if (!quit && !WriteAll(fd, reply.data(), reply.size())) break;
+    }
+    close(fd);
+  }
+  close(listen_fd);
+  if (address.rfind("unix:", 0) == 0) unlink(address.substr(5).c_str());
+  return true;
+}
+
+CostClient::CostClient(const std::string &address, double timeout)
+    : fd_(ConnectSocket(address, timeout)) {}
+
+CostClient::~CostClient() {
+  if (fd_ >= 0) close(fd_);
+}
+
+bool CostClient::Request(const std::string &request, std::string &reply) {
+  const std::string line = request + "\n";
+  return fd_ >= 0 && WriteAll(fd_, line.data(), line.size()) &&
+         ReadLine(fd_, buffer_, reply);
+}
+
+bool CostClient::Evaluate(const std::string &request,
+                          CostFunction::Result &result) {
+  std::string reply;
+  if (!Request(request, reply)) return false;
+  std::istringstream in(reply);
+  return (bool)(in >> result.area >> result.power >> result.dynamic_power >>
+                result.cost);
+}
@@ -0,0 +1,65 @@
+#ifndef COST_COST_SERVER_HH
+#define COST_COST_SERVER_HH
+
+#include <iostream>
+#include <string>
+
+#include "cost_estimator.hh"
+
+/**
+ * Long-lived cost evaluation, so that the library is loaded once and each
+ * netlist is parsed once instead of once per evaluation. Requests are lines:
+ *
+ *   netlist PATH                 loads (replaces) the netlist at PATH
+ *   set GATE CELL [GATE CELL..]  changes the cells of gates to other
+ *                                variants of their type, by index in
+ *                                netlist order, e.g. `set 12 nand_3`
+ *   cost                         evaluates the current netlist
+ *   gates                        replies the number of gates instead
+ *   quit                         ends the session
+ *
+ * Each other request gets one reply line, the evaluation after it:
+ * `area power dynamic_power cost`, or `error MESSAGE` leaving the netlist
+ * as it was before the request (all of a `set` or nothing).
+ */
+
+/// @brief Handles one request line.
+/// @param quit set if the request ends the session
+/// @return reply line, without the newline
+std::string HandleCostRequest(CostFunction &f, const std::string &request,
+                              bool &quit);
+
+/// @brief Serves requests from `in` until quit or the end of input.
+void ServeCostRequests(CostFunction &f, std::istream &in, std::ostream &out);
+
+/// @brief Serves clients connecting to `address` ("unix:PATH", see
+///        socket.hh), one at a time, until a client sends quit.
+/// @return false if it cannot listen on `address`
+bool ServeCostSocket(CostFunction &f, const std::string &address);
+
+/// @brief Client side of a cost server listening on a socket.
+class CostClient {
+ public:
+  /// @brief Connects, waiting up to `timeout` seconds for the server.
+  explicit CostClient(const std::string &address, double timeout = 10);
+  ~CostClient();
+  CostClient(const CostClient &) = delete;
+  CostClient &operator=(const CostClient &) = delete;
+
+  bool ok() const { return fd_ >= 0; }
+
+  /// @brief Sends a request line (without the newline) and waits for the
+  ///        reply.
+  /// @return false if the server is gone
+  bool Request(const std::string &request, std::string &reply);
+
+  /// @brief Request() parsing the reply.
+  /// @return false if the server is gone or replied with an error
+  bool Evaluate(const std::string &request, CostFunction::Result &result);
+
+ private:
+  int fd_;
+  std::string buffer_;  // received past the last reply
+};
+
+#endif  // COST_COST_SERVER_HH
@@ -6,12 +6,12 @@
 #include <iostream>
 #include <vector>
 
-std::vector<std::chrono::_V2::system_clock::time_point> times;
+inline std::vector<std::chrono::_V2::system_clock::time_point> times;
 
 /**
  * @brief Starts the clock, pushes the current time onto a the stack.
  */
-void StartClock() {
+inline void StartClock() {
   times.push_back(std::chrono::high_resolution_clock::now());
 }
 
@@ -20,7 +20,7 @@ void StartClock() {
  *
  * @return double time elasped
  */
-double EndClock() {
+inline double EndClock() {
   auto t0_ = times.back();
   times.pop_back();
   using std::chrono::duration;
@@ -39,7 +39,7 @@ double EndClock() {
  *
  * @param label text printed before the elapsed time.
  */
-void EndClockPrint(const std::string& label) {
+inline void EndClockPrint(const std::string& label) {
   std::cout << std::fixed << std::setprecision(6);
   std::cout << std::setw(10) << EndClock() << "ms" << " " << label << std::endl;
 }
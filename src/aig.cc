@@ -1,13 +1,150 @@
 #include "aig.hh"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+#include "parallel.hh"
+#include "serialization.hh"
+
 #define FMT_HEADER_ONLY  // make sure FMT only gets compiled once
 #include "aig_reader.hh"
 
 void AIG::Load(const std::filesystem::path& file) {
+  if (!ParseBinaryAIGER(file)) ParseAIGER(file);
+  Strash();
+  if (simulation_patterns_ > 0) {
+    SimulateSetProbability(simulation_patterns_);
+  } else {
+    ComputeSetProbability();
+  }
+  ComputeOutDegree();
+  BuildFanoutIndex();
+}
+
+bool AIG::ParseAIGER(const std::filesystem::path& file) {
   AIGReader reader((AIG&)*this);
   auto result = lorina::read_aiger(file, reader);
-  ComputeSetProbability();
-  ComputeOutDegree();
+  return result == lorina::return_code::success;
+}
+
+namespace {
+
+/**
+ * @brief Reads an unsigned decimal, skipping leading spaces.
+ *
+ * @return false if there are no digits at `p`
+ */
+bool ReadUnsigned(const char*& p, const char* end, uint64_t& x) {
+  while (p < end && *p == ' ') ++p;
+  if (p == end || *p < '0' || *p > '9') return false;
+  x = 0;
+  while (p < end && *p >= '0' && *p <= '9') x = x * 10 + (*p++ - '0');
+  return true;
+}
+
+/**
+ * @brief Skips to the character after the next newline.
+ */
+void SkipLine(const char*& p, const char* end) {
+  while (p < end && *p != '\n') ++p;
+  if (p < end) ++p;
+}
+
+}  // namespace
+
+bool AIG::ParseBinaryAIGER(const std::filesystem::path& file) {
+  MappedFile mapped(file);
+  if (mapped.size() < 4) return false;
+
+  const char* p = mapped.data();
+  const char* const end = p + mapped.size();
+
+  // header -- "aig M I L O A", latches are not supported
+  if (p[0] != 'a' || p[1] != 'i' || p[2] != 'g' || p[3] != ' ') return false;
+  p += 3;
+  uint64_t m, i, l, o, a;
+  if (!ReadUnsigned(p, end, m) || !ReadUnsigned(p, end, i) ||
+      !ReadUnsigned(p, end, l) || !ReadUnsigned(p, end, o) ||
+      !ReadUnsigned(p, end, a)) {
+    return false;
+  }
+  if (l != 0 || m != i + a) return false;
+  SkipLine(p, end);
+  LoadHeader(m, i, o, a);
+
+  // inputs are implicit in the binary format, input k is literal 2(k+1)
+  // Note: literals are 1-indexed, but 0-indexed is easier to work with
+  for (int k = 0; k < sz_i_; ++k) SetInputPort(k, k * 2);
+
+  for (int k = 0; k < sz_o_; ++k) {
+    uint64_t lit;
+    if (!ReadUnsigned(p, end, lit) || lit < 2 || lit >= 2 * m + 2) {
+      return false;
+    }
+    SetOutputPort(k, lit - 2);
+    SkipLine(p, end);
+  }
+
+  // AND section -- each gate is two 7-bit varint deltas:
+  // lhs - rhs0 and rhs0 - rhs1, with lhs > rhs0 >= rhs1
+  const auto* q = reinterpret_cast<const uint8_t*>(p);
+  const auto* const qend = reinterpret_cast<const uint8_t*>(end);
+  uint32_t lhs = 2 * (sz_i_ + 1);
+  for (int k = 0; k < sz_a_; ++k, lhs += 2) {
+    uint32_t delta[2];
+    for (auto& x : delta) {
+      uint32_t shift = 0;
+      x = 0;
+      uint8_t ch;
+      do {
+        if (q == qend || shift > 28) return false;  // more than 32 bits
+        ch = *q++;
+        x |= (uint32_t)(ch & 0x7f) << shift;
+        shift += 7;
+      } while (ch & 0x80);
+    }
+    // rhs0 and rhs1 are at least literal 2, checked before subtracting
+    // since a larger delta would wrap around
+    if (delta[0] == 0 || delta[0] > lhs - 2) return false;
+    const uint32_t rhs0 = lhs - delta[0];
+    if (delta[1] > rhs0 - 2) return false;
+    const uint32_t rhs1 = rhs0 - delta[1];
+    nodes_.inputs[lhs - 2] = {(int)rhs1 - 2, (int)rhs0 - 2};
+  }
+  p = reinterpret_cast<const char*>(q);
+
+  // symbol table and comment section
+  while (p < end) {
+    const char kind = *p++;
+    if (kind == 'c') {
+      SkipLine(p, end);
+      const char* word_end = p;
+      while (word_end < end && *word_end != ' ' && *word_end != '\n' &&
+             *word_end != '\r') {
+        ++word_end;
+      }
+      SetModuleName(std::string(p, word_end));
+      break;
+    }
+    uint64_t pos;
+    if ((kind != 'i' && kind != 'o') || !ReadUnsigned(p, end, pos)) {
+      SkipLine(p, end);
+      continue;
+    }
+    if (p < end && *p == ' ') ++p;
+    const char* name_end = p;
+    while (name_end < end && *name_end != '\n') ++name_end;
+    std::string name(p, name_end);
+    if (kind == 'i' && pos < (uint64_t)sz_i_) SetInputNetName(pos, name);
+    if (kind == 'o' && pos < (uint64_t)sz_o_) SetOutputNetName(pos, name);
+    p = name_end;
+    SkipLine(p, end);
+  }
+  return true;
 }
 
 void AIG::LoadHeader(int v, int i, int o, int a) {
@@ -15,59 +152,211 @@ void AIG::LoadHeader(int v, int i, int o, int a) {
   sz_i_ = i;
   sz_o_ = o;
   sz_a_ = a;
-  nodes_.assign(v * 2, Node());
+  nodes_.assign(v * 2);
   gates_.assign(v * 2, Gate());
   inputs_.assign(sz_i_, -1);
   outputs_.assign(sz_o_, -1);
 
-  // initialize names
-  net_names_.assign(v * 2, "v");
-  for (int i = 0; i < v * 2; ++i) net_names_[i] += std::to_string(i);
+  // names default to "v<literal>", only I/O names get stored
+  net_names_.clear();
 }
 
-void AIG::ComputeSetProbability() {
-  for (int u : outputs_) {
-    ComputeSetProbabilityRecursive(u);
+int AIG::Strash() {
+  auto t0 = std::chrono::steady_clock::now();
+
+  // a pinned variable drives an output, merging it would make two outputs
+  // share a literal (and a name)
+  std::vector<uint8_t> pinned(sz_v_, false);
+  for (int x : outputs_) pinned[x / 2] = true;
+
+  // open-addressing table of new variables keyed on their fanin pair
+  int bits = 1;
+  while ((1 << bits) < 2 * (sz_a_ + 1)) ++bits;
+  const uint32_t mask = (1u << bits) - 1;
+  std::vector<int> table(mask + 1, -1);
+  auto slot_of = [&](int x, int y) {
+    uint64_t key = (uint64_t)(uint32_t)x << 32 | (uint32_t)y;
+    return (uint32_t)((key * 0x9e3779b97f4a7c15ULL) >> (64 - bits));
+  };
+
+  std::vector<int> remap(sz_v_);  // old variable -> new literal
+  std::vector<std::array<int, 2>> new_inputs;
+  new_inputs.reserve(sz_v_ * 2);
+  new_inputs.assign(sz_i_ * 2, {-1, -1});
+  for (int v = 0; v < sz_i_; ++v) remap[v] = v * 2;
+
+  // ASCII AIGER may list AND gates before their fanins, visit them in
+  // topological order then (Kahn's algorithm)
+  bool sorted = true;
+  for (int v = sz_i_; v < sz_v_ && sorted; ++v) {
+    auto [x, y] = nodes_.inputs[v * 2];
+    sorted = x / 2 < v && y / 2 < v;
+  }
+  std::vector<int> order(sz_v_ - sz_i_);
+  std::iota(order.begin(), order.end(), sz_i_);
+  if (!sorted) {
+    std::vector<int> deps(sz_v_, 0);
+    std::vector<std::vector<int>> readers(sz_v_);
+    for (int v = sz_i_; v < sz_v_; ++v) {
+      for (int x : nodes_.inputs[v * 2]) {
+        if (x / 2 < sz_i_) continue;
+        ++deps[v];
+        readers[x / 2].push_back(v);
+      }
+    }
+    order.clear();
+    for (int v = sz_i_; v < sz_v_; ++v) {
+      if (deps[v] == 0) order.push_back(v);
+    }
+    for (size_t k = 0; k < order.size(); ++k) {
+      for (int v : readers[order[k]]) {
+        if (--deps[v] == 0) order.push_back(v);
+      }
+    }
+    if ((int)order.size() != sz_v_ - sz_i_) {
+      throw std::runtime_error("AIG::Strash: the AND gates form a cycle");
+    }
+  }
+
+  int merged = 0;
+  for (int v : order) {
+    auto [x, y] = nodes_.inputs[v * 2];
+    x = remap[x / 2] ^ (x & 1);
+    y = remap[y / 2] ^ (y & 1);
+    if (x > y) std::swap(x, y);
+
+    if (x == y && !pinned[v]) {  // x & x = x
+      remap[v] = x;
+      ++merged;
+      continue;
+    }
+
+    uint32_t slot = slot_of(x, y);
+    while (table[slot] != -1 && new_inputs[table[slot]] != std::array{x, y}) {
+      slot = (slot + 1) & mask;
+    }
+    if (table[slot] != -1 && !pinned[v]) {
+      remap[v] = table[slot];
+      ++merged;
+      continue;
+    }
+
+    const int z = new_inputs.size();
+    if (table[slot] == -1) table[slot] = z;
+    remap[v] = z;
+    new_inputs.push_back({x, y});
+    new_inputs.push_back({-1, -1});
+  }
+
+  if (merged || !sorted) {
+    // names are keyed by literal, keep the explicit ones across renumbering
+    std::vector<std::string> input_names(sz_i_), output_names(sz_o_);
+    for (int k = 0; k < sz_i_; ++k) {
+      if (net_names_.is_named(inputs_[k])) {
+        input_names[k] = net_names_.str(inputs_[k]);
+      }
+    }
+    for (int k = 0; k < sz_o_; ++k) {
+      if (net_names_.is_named(outputs_[k])) {
+        output_names[k] = net_names_.str(outputs_[k]);
+      }
+    }
+
+    const int new_v = new_inputs.size() / 2;
+    std::vector<int> inputs = inputs_, outputs = outputs_;
+    LoadHeader(new_v, sz_i_, sz_o_, new_v - sz_i_);
+    nodes_.inputs = std::move(new_inputs);
+    for (int k = 0; k < sz_i_; ++k) {
+      SetInputPort(k, inputs[k]);  // inputs keep their literals
+      if (!input_names[k].empty()) SetInputNetName(k, input_names[k]);
+    }
+    for (int k = 0; k < sz_o_; ++k) {
+      SetOutputPort(k, remap[outputs[k] / 2] ^ (outputs[k] & 1));
+      if (!output_names[k].empty()) SetOutputNetName(k, output_names[k]);
+    }
+  }
+
+  auto t1 = std::chrono::steady_clock::now();
+  std::cout << "[strash] merged=" << merged << " ands=" << sz_a_ << " time="
+            << std::chrono::duration<double, std::milli>(t1 - t0).count()
+            << "ms" << std::endl;
+  return merged;
+}
+
+void AIG::BuildFanoutIndex() {
+  fanout_offsets_.assign(sz_v_ * 2 + 1, 0);
+  for (int v = sz_i_; v < sz_v_; ++v) {
+    auto [a, b] = nodes_.inputs[v * 2];
+    ++fanout_offsets_[a + 1];
+    ++fanout_offsets_[b + 1];
+  }
+  for (int i = 0; i < sz_v_ * 2; ++i) {
+    fanout_offsets_[i + 1] += fanout_offsets_[i];
+  }
+
+  fanout_targets_.resize(fanout_offsets_.back());
+  std::vector<uint32_t> fill(fanout_offsets_.begin(), fanout_offsets_.end() - 1);
+  for (int v = sz_i_; v < sz_v_; ++v) {
+    auto [a, b] = nodes_.inputs[v * 2];
+    fanout_targets_[fill[a]++] = v * 2;
+    fanout_targets_[fill[b]++] = v * 2;
   }
 }
 
-void AIG::ComputeSetProbabilityRecursive(int u) {
-  if (nodes_[u].set_prob != -1) return;
-  if (u & 1 == 1) {  // is an Inverter
-    ComputeSetProbabilityRecursive(u ^ 1);
-    nodes_[u].set_prob = 1 - nodes_[u ^ 1].set_prob;
-  } else if (u < sz_i_ * 2) {  // is an Input port
-    nodes_[u].set_prob = 0.5;
-  } else {  // is an And gate
-    auto [x, y] = nodes_[u].inputs;
-    assert(x != -1 && "Dependency x for And gate should exist.");
-    assert(y != -1 && "Dependency y for And gate should exist.");
-    ComputeSetProbabilityRecursive(x);
-    ComputeSetProbabilityRecursive(y);
-    double p = nodes_[x].set_prob * nodes_[y].set_prob;
-    nodes_[u].set_prob = p;
-    nodes_[u].q = 2 * p * (1.0 - p);
+void AIG::ComputeLevels() {
+  std::vector<int> level(sz_v_, 0);
+  int depth = 0;
+  for (int v = sz_i_; v < sz_v_; ++v) {
+    auto [x, y] = nodes_.inputs[v * 2];
+    level[v] = std::max(level[x / 2], level[y / 2]) + 1;
+    depth = std::max(depth, level[v]);
   }
+
+  // counting sort by level, stays in index order within a level
+  level_offsets_.assign(depth + 2, 0);
+  for (int v = 0; v < sz_v_; ++v) ++level_offsets_[level[v] + 1];
+  for (int l = 0; l <= depth; ++l) level_offsets_[l + 1] += level_offsets_[l];
+  level_vars_.resize(sz_v_);
+  std::vector<int> fill(level_offsets_.begin(), level_offsets_.end() - 1);
+  for (int v = 0; v < sz_v_; ++v) level_vars_[fill[level[v]]++] = v;
+}
+
+void AIG::ComputeSetProbability() {
+  if (num_threads_ <= 1) {
+    for (int v = 0; v < sz_v_; ++v) ComputeSetProbability(v);
+    return;
+  }
+
+  ComputeLevels();
+  const int num_levels = level_offsets_.size() - 1;
+  Barrier barrier(num_threads_);
+  RunThreads(num_threads_, [&](int thread_id) {
+    for (int l = 0; l < num_levels; ++l) {
+      auto [begin, end] = ThreadRange(level_offsets_[l], level_offsets_[l + 1],
+                                      thread_id, num_threads_);
+      for (int k = begin; k < end; ++k) ComputeSetProbability(level_vars_[k]);
+      barrier.Wait();
+    }
+  });
 }
 
 void AIG::ComputeOutDegree() {
   for (int i = 0; i < sz_v_; ++i) {
-    nodes_[i * 2].out_degree = nodes_[i * 2 + 1].out_degree = 0;
+    nodes_.out_degree[i * 2] = nodes_.out_degree[i * 2 + 1] = 0;
   }
 
   for (auto x : outputs_) {
-    ++nodes_[x].out_degree;
+    ++nodes_.out_degree[x];
   }
 
   for (int i = sz_i_; i < sz_v_; ++i) {
-    auto& u = nodes_[i * 2];
-    auto [a, b] = u.inputs;
-    ++nodes_[a].out_degree;
-    ++nodes_[b].out_degree;
+    auto [a, b] = nodes_.inputs[i * 2];
+    ++nodes_.out_degree[a];
+    ++nodes_.out_degree[b];
   }
 
   // for (int i = 0; i < 2*sz_v_; ++i) {
-  //   std::cout << nodes_[i].out_degree << " ";
+  //   std::cout << nodes_.out_degree[i] << " ";
   //   if (i % 10 == 9) std::cout << "\n";
   // }
   // std::cout << std::endl;
@@ -3,10 +3,16 @@
 
 #include <array>
 #include <cassert>
+#include <cstdint>
 #include <filesystem>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "cell.hh"
+#include "utils.hh"
 
 /**
  * @brief Represents a sequential And-Inverter Graph. Handles read/write, but
@@ -19,11 +25,32 @@ class AIG {
 
   /**
    * @brief Loads the file into the AIG, parses and then finalizes.
+   * Binary AIGER (.aig) files are decoded natively, anything else (ASCII .aag)
+   * falls back to lorina.
    *
    * @param file source path
    */
   void Load(const std::filesystem::path& file);
 
+  /**
+   * @brief Parses a binary AIGER file by memory-mapping it and decoding the
+   * AND section directly into `nodes_`. Does not finalize.
+   *
+   * @param file source path
+   * @return true if parsed, false if the file is not a combinational binary
+   * AIGER file (caller should fall back to ParseAIGER)
+   */
+  bool ParseBinaryAIGER(const std::filesystem::path& file);
+
+  /**
+   * @brief Parses any AIGER file through lorina and AIGReader callbacks.
+   * Does not finalize.
+   *
+   * @param file source path
+   * @return true if parsed successfully
+   */
+  bool ParseAIGER(const std::filesystem::path& file);
+
   /**
    * @brief Loads the header
    *
@@ -42,7 +69,7 @@ class AIG {
    */
   void SetInputPort(int index, int variable) {
     inputs_[index] = variable;
-    nodes_[variable].is_io = true;
+    nodes_.is_io[variable] = true;
   }
 
   /**
@@ -53,7 +80,7 @@ class AIG {
    */
   void SetOutputPort(int index, int variable) {
     outputs_[index] = variable;
-    nodes_[variable].is_io = true;
+    nodes_.is_io[variable] = true;
   }
 
   /**
@@ -69,7 +96,7 @@ class AIG {
     assert(variable >= sz_i_ * 2 && "Inputs do not have dependencies.");
     assert(lhs != rhs && "Dependencies should be distinct, it is AND not BUF.");
     if (lhs > rhs) std::swap(lhs, rhs);
-    nodes_[variable].inputs = {lhs, rhs};
+    nodes_.inputs[variable] = {lhs, rhs};
   }
 
   void SetModuleName(const std::string& module_name) {
@@ -83,7 +110,7 @@ class AIG {
    * @param name
    */
   void SetInputNetName(int input_index, const std::string& name) {
-    net_names_[inputs_[input_index]] = name;
+    net_names_.Set(inputs_[input_index], name);
   }
 
   /**
@@ -93,7 +120,7 @@ class AIG {
    * @param name
    */
   void SetOutputNetName(int output_index, const std::string& name) {
-    net_names_[outputs_[output_index]] = name;
+    net_names_.Set(outputs_[output_index], name);
   }
 
   const auto sz_v() const { return sz_v_; }  // # of variables
@@ -102,23 +129,196 @@ class AIG {
   const auto sz_a() const { return sz_a_; }  // # of AND gates
   const auto& nodes() const { return nodes_; }
   const auto& gates() const { return gates_; }
+  const auto& net_names() const { return net_names_; }
+
+  /**
+   * @brief (Re)builds the compressed sparse row fanout index from the AND
+   * gate fanins. Load() invokes this; call it again after editing the graph.
+   */
+  void BuildFanoutIndex();
+
+  /**
+   * @brief The AND gates reading `literal`, as their (even) literals in
+   * increasing order. Output ports and the literal's own inverter are not
+   * included.
+   *
+   * @param literal
+   * @return Span<const uint32_t>
+   */
+  Span<const uint32_t> fanouts(int literal) const {
+    const uint32_t* targets = fanout_targets_.data();
+    return {targets + fanout_offsets_[literal],
+            targets + fanout_offsets_[literal + 1]};
+  }
+
+  /**
+   * @brief Sets how many threads the load-time passes may use.
+   * Must be called before Load() to take effect there.
+   */
+  void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+  const auto num_threads() const { return num_threads_; }
+
+  /**
+   * @brief Sets how many random patterns Load() simulates for the set
+   * probabilities and q, see SimulateSetProbability(). 0 (the default) keeps
+   * the analytic ComputeSetProbability(). Must be called before Load().
+   */
+  void set_simulation_patterns(long long num_patterns) {
+    simulation_patterns_ = num_patterns;
+  }
+  const auto simulation_patterns() const { return simulation_patterns_; }
+
+  /**
+   * @brief Groups the variables by logic level (inputs are level 0). Level l
+   * holds `level_vars()[level_offsets()[l] .. level_offsets()[l+1])`.
+   * Variables within a level do not depend on each other.
+   */
+  void ComputeLevels();
+
+  const auto& level_offsets() const { return level_offsets_; }
+  const auto& level_vars() const { return level_vars_; }
+
+  /**
+   * @brief Computes the set probability and q for all AIG nodes in a single
+   * forward sweep. Strash() orders fanins before the AND gates reading them,
+   * so index order is topological. With more than one thread, each level is
+   * processed in parallel instead. Load() invokes this at the end unless
+   * simulation_patterns() is set.
+   */
+  void ComputeSetProbability();
+
+  /**
+   * @brief Structural hashing. Merges AND gates with identical (ordered)
+   * fanins and renumbers the variables so they stay dense and topologically
+   * ordered, sorting them first if the file listed a gate before its fanins.
+   * Nodes driving an output are never merged away, so every output keeps its
+   * own literal and name. Load() invokes this before finalizing.
+   *
+   * @return number of AND gates merged
+   * @throws std::runtime_error if the AND gates form a cycle
+   */
+  int Strash();
 
- protected:
   /**
-   * @brief Represents an AIG node, it's index in the node list determines
-   * whether it is an AND gate or INVERTER.
+   * @brief Estimates set probability and q for all AIG nodes by random
+   * simulation, which accounts for reconvergent fanout. Patterns are packed
+   * 64 per machine word and simulated in blocks; blocks are split over
+   * `num_threads()` threads. `set_prob` is the fraction of patterns where the
+   * node is 1 and `q` is the measured toggle rate between consecutive
+   * patterns. Results only depend on `seed`, not on the thread count.
+   *
+   * @param num_patterns number of patterns, rounded up to a whole block
+   * @param seed random seed for the input patterns
    */
-  struct Node {
-    double set_prob = -1;  // set probability (used in dynamic power)
-    double q;            // leakage coefficient used in dynamic power q=2p(1-p)
-    int out_degree = 0;  // how many other nodes depend on this
-    bool is_io = false;  // is I/O port?
+  void SimulateSetProbability(long long num_patterns, uint64_t seed = 1);
 
+ protected:
+  /**
+   * @brief Holds the AIG nodes as a structure of arrays, indexed by literal.
+   * A node's index determines whether it is an AND gate or INVERTER. Hot
+   * traversals only touch the arrays they need.
+   */
+  struct Nodes {
     /**
      * @brief The inputs (dependencies) of the And gate. When this represents
      * an Inverter gate, the inputs stay as {-1, -1};
      */
-    std::array<int, 2> inputs = {-1, -1};
+    std::vector<std::array<int, 2>> inputs;
+    std::vector<double> set_prob;  // set probability (used in dynamic power)
+    std::vector<float> q;  // leakage coefficient in dynamic power q=2p(1-p)
+    std::vector<int> out_degree;  // how many other nodes depend on this
+    std::vector<uint8_t> is_io;   // is I/O port?
+
+    /**
+     * @brief Resets all arrays to `n` default nodes.
+     */
+    void assign(size_t n) {
+      inputs.assign(n, {-1, -1});
+      set_prob.assign(n, -1);
+      q.assign(n, 0);
+      out_degree.assign(n, 0);
+      is_io.assign(n, false);
+    }
+
+    size_t size() const { return inputs.size(); }
+
+    template <class Archive>
+    void Serialize(Archive& ar) {
+      ar(inputs, set_prob, q, out_degree, is_io);
+    }
+  };
+
+  /**
+   * @brief Net names indexed by literal. Only explicitly named nets (the I/O
+   * ports) are stored, packed in one string arena. Every other literal `i` is
+   * named "v<i>" on the fly when printed.
+   */
+  class NetNames {
+   public:
+    /**
+     * @brief Printable name of one literal, `out << net_names_[i]` writes it
+     * without allocating.
+     */
+    struct Name {
+      const NetNames* names;
+      int literal;
+
+      friend std::ostream& operator<<(std::ostream& os, const Name& name) {
+        return name.names->Print(os, name.literal);
+      }
+    };
+
+    std::ostream& Print(std::ostream& os, int literal) const {
+      auto it = named_.find(literal);
+      if (it == named_.end()) return os << 'v' << literal;
+      auto [offset, length] = it->second;
+      return os << std::string_view(arena_.data() + offset, length);
+    }
+
+    void clear() {
+      arena_.clear();
+      named_.clear();
+    }
+
+    /**
+     * @brief Overrides the name of `literal`.
+     */
+    void Set(int literal, const std::string& name) {
+      named_[literal] = {(uint32_t)arena_.size(), (uint32_t)name.size()};
+      arena_ += name;
+    }
+
+    bool is_named(int literal) const { return named_.count(literal); }
+
+    /**
+     * @brief Name of `literal` as a string, generated if not named.
+     */
+    std::string str(int literal) const {
+      auto it = named_.find(literal);
+      if (it == named_.end()) return "v" + std::to_string(literal);
+      return arena_.substr(it->second.first, it->second.second);
+    }
+
+    Name operator[](int literal) const { return {this, literal}; }
+
+    template <class Archive>
+    void Serialize(Archive& ar) {
+      ar(arena_, named_);
+    }
+
+    /**
+     * @brief Approximate heap usage in bytes.
+     */
+    size_t memory() const {
+      return arena_.capacity() +
+             named_.size() * (sizeof(void*) + sizeof(*named_.begin())) +
+             named_.bucket_count() * sizeof(void*);
+    }
+
+   private:
+    std::string arena_;  // all explicit names back to back
+    // literal -> (offset, length) into arena_
+    std::unordered_map<int, std::pair<uint32_t, uint32_t>> named_;
   };
 
   /**
@@ -126,7 +326,7 @@ class AIG {
    */
   struct Gate {
     bool active = false;         // whether it is used
-    const Cell* cell = nullptr;  // instance of what cell
+    Cell::Id cell = Cell::kNoId;  // instance of what cell (library id)
     int a;                       // input a (aig net)
     int b;                       // input b -- value isn't used in unary gate
     int y;                       // output y
@@ -146,24 +346,39 @@ class AIG {
   std::vector<int> inputs_;      // variable name of the ith input
   std::vector<int> outputs_;     // variable name of the ith output
   std::string top_module_name_;  // name of the top module (used in export)
-  std::vector<std::string> net_names_;  // use same index as nodes_
+  NetNames net_names_;           // use same index as nodes_
 
-  std::vector<Node> nodes_;
+  Nodes nodes_;
   std::vector<Gate> gates_;
 
- private:
-  /**
-   * @brief Helper function to computes the set probability for all AIG nodes.
-   * Load() invokes this at the end.
-   */
-  void ComputeSetProbability();
+  std::vector<uint32_t> fanout_offsets_;  // fanouts of literal i start here
+  std::vector<uint32_t> fanout_targets_;  // reading AND gates, by literal
+
+  int num_threads_ = 1;                // threads used by load-time passes
+  long long simulation_patterns_ = 0;  // 0 for the analytic probabilities
+  std::vector<int> level_offsets_;     // level l starts at level_offsets_[l]
+  std::vector<int> level_vars_;        // variables sorted by level
 
+ private:
   /**
-   * @brief Recursive computation for ComputeSetProbability
+   * @brief Computes the set probability and q of variable `v`. Both its
+   * literals are updated, the fanins must be computed already.
    *
-   * @param u variable that is being currently computed
+   * @param v variable (literal / 2)
    */
-  void ComputeSetProbabilityRecursive(int u);
+  void ComputeSetProbability(int v) {
+    double p = 0.5;  // is an Input port
+    if (v >= sz_i_) {  // is an And gate
+      auto [x, y] = nodes_.inputs[v * 2];
+      assert(x != -1 && "Dependency x for And gate should exist.");
+      assert(y != -1 && "Dependency y for And gate should exist.");
+      p = nodes_.set_prob[x] * nodes_.set_prob[y];
+    }
+    const float q = 2 * p * (1.0 - p);  // same for the Inverter
+    nodes_.set_prob[v * 2] = p;
+    nodes_.set_prob[v * 2 + 1] = 1 - p;
+    nodes_.q[v * 2] = nodes_.q[v * 2 + 1] = q;
+  }
 };
 
 #endif  // SRC_AIG_HH_
\ No newline at end of file
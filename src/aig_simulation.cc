@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "aig.hh"
+#include "parallel.hh"
+#include "random.hh"
+
+namespace {
+
+constexpr int kWordsPerBlock = 4;  // 256 patterns per block
+constexpr int kPatternsPerBlock = kWordsPerBlock * 64;
+
+// Uses the compiler's vector extension so the block-wide AND/XOR map onto
+// SIMD registers where the target has them.
+#if defined(__GNUC__)
+typedef uint64_t Block
+    __attribute__((vector_size(kWordsPerBlock * sizeof(uint64_t))));
+#else
+struct Block {
+  uint64_t w[kWordsPerBlock];
+  uint64_t operator[](int i) const { return w[i]; }
+  uint64_t& operator[](int i) { return w[i]; }
+  Block operator&(const Block& o) const {
+    Block r;
+    for (int i = 0; i < kWordsPerBlock; ++i) r.w[i] = w[i] & o.w[i];
+    return r;
+  }
+  Block operator^(const Block& o) const {
+    Block r;
+    for (int i = 0; i < kWordsPerBlock; ++i) r.w[i] = w[i] ^ o.w[i];
+    return r;
+  }
+};
+#endif
+
+}  // namespace
+
+void AIG::SimulateSetProbability(long long num_patterns, uint64_t seed) {
+  const int num_blocks =
+      std::max(1LL, (num_patterns + kPatternsPerBlock - 1) / kPatternsPerBlock);
+  const int num_threads = std::max(1, std::min(num_threads_, num_blocks));
+
+  std::vector<uint64_t> ones(sz_v_, 0);     // patterns where the var is 1
+  std::vector<uint64_t> toggles(sz_v_, 0);  // changes between patterns
+  std::mutex mutex;
+
+  RunThreads(num_threads, [&](int thread_id) {
+    std::vector<Block> values(sz_v_);
+    std::vector<uint64_t> local_ones(sz_v_, 0);
+    std::vector<uint64_t> local_toggles(sz_v_, 0);
+    Block negate[2];
+    for (int w = 0; w < kWordsPerBlock; ++w) {
+      negate[0][w] = 0;
+      negate[1][w] = ~0ULL;
+    }
+
+    auto [first, last] = ThreadRange(0, num_blocks, thread_id, num_threads);
+    for (int block = first; block < last; ++block) {
+      // patterns depend on (seed, block) only, not on the thread split
+      uint64_t state = seed ^ ((block + 1) * 0xd1b54a32d192ed03ULL);
+      for (int v = 0; v < sz_i_; ++v) {
+        for (int w = 0; w < kWordsPerBlock; ++w) {
+          values[v][w] = SplitMix64(state);
+        }
+      }
+      for (int v = sz_i_; v < sz_v_; ++v) {
+        auto [x, y] = nodes_.inputs[v * 2];
+        values[v] = (values[x >> 1] ^ negate[x & 1]) &
+                    (values[y >> 1] ^ negate[y & 1]);
+      }
+      for (int v = sz_i_; v < sz_v_; ++v) {
+        const Block& value = values[v];
+        uint64_t set = 0, changed = 0;
+        for (int w = 0; w < kWordsPerBlock; ++w) {
+          // bit j vs bit j+1 within a word -- 63 comparisons per word
+          set += __builtin_popcountll(value[w]);
+          changed += __builtin_popcountll((value[w] ^ (value[w] >> 1)) &
+                                          0x7fffffffffffffffULL);
+        }
+        local_ones[v] += set;
+        local_toggles[v] += changed;
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int v = sz_i_; v < sz_v_; ++v) {
+      ones[v] += local_ones[v];
+      toggles[v] += local_toggles[v];
+    }
+  });
+
+  const double patterns = (double)num_blocks * kPatternsPerBlock;
+  const double comparisons = (double)num_blocks * kWordsPerBlock * 63;
+  for (int v = 0; v < sz_v_; ++v) {
+    // primary inputs are uniform by definition
+    double p = v < sz_i_ ? 0.5 : ones[v] / patterns;
+    float q = v < sz_i_ ? 0.5 : toggles[v] / comparisons;
+    nodes_.set_prob[v * 2] = p;
+    nodes_.set_prob[v * 2 + 1] = 1 - p;
+    nodes_.q[v * 2] = nodes_.q[v * 2 + 1] = q;
+  }
+}
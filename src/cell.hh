@@ -1,6 +1,7 @@
 #ifndef ICCAD_SRC_CELL_H_
 #define ICCAD_SRC_CELL_H_
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -22,6 +23,22 @@ class Cell {
   const auto& type() const { return type_; }
   const auto& leakage_power() const { return leakage_power_; }
   const auto& area() const { return area_; }
+  const auto& b() const { return b_; }  // attr_b, the delay used in timing
+  const auto& capacitance() const { return c_; }
+  const auto& power_domain() const { return pd_; }
+
+  /// @brief dense index of a cell in its Library, see Library::Compile
+  typedef uint16_t Id;
+  static constexpr Id kNoId = 0xffff;
+
+  /**
+   * @brief Passes every field to `ar`, see serialization.hh.
+   */
+  template <class Archive>
+  void Serialize(Archive& ar) {
+    ar(name_, type_, f_properties_, i_properties_, a_, b_, pd_,
+       leakage_power_, c_, area_, max_c_);
+  }
 
   /**
    * @brief enumerable for cell types
@@ -41,6 +58,8 @@ class Cell {
     kMaskInverted = 1,  // if (type & Type::kMaskInverted) type is inverted
     kMaskUnary = 8,     // if (type & Type::kMaskUnary) type is unary input gate
     kMaskBaseGate = 2 | 4 | 6 | 24,  // removes the isInverted bit
+
+    kNumTypes = 32,  // every type is less than this
   };
 
  private:
@@ -0,0 +1,174 @@
+#include "cut_enumerator.hh"
+
+#include <algorithm>
+
+#include "parallel.hh"
+
+namespace {
+
+typedef CutEnumerator::Cut Cut;
+
+// truth table of leaf i, over 4 leaves
+constexpr uint16_t kLeafTruth[4] = {0xaaaa, 0xcccc, 0xf0f0, 0xff00};
+
+/**
+ * @brief Re-expresses the truth table of `cut` over `leaves`, which must be a
+ * superset of the leaves of `cut`.
+ */
+uint16_t Expand(const Cut& cut, const int* leaves) {
+  int position[CutEnumerator::kMaxCutSize];  // where cut.leaves[i] sits
+  bool identity = true;
+  for (int i = 0, j = 0; i < cut.size; ++i) {
+    while (leaves[j] != cut.leaves[i]) ++j;
+    position[i] = j;
+    identity = identity && i == j;
+  }
+  if (identity) return cut.truth;
+  uint16_t truth = 0;
+  for (int m = 0; m < 16; ++m) {
+    int sub = 0;
+    for (int i = 0; i < cut.size; ++i) sub |= ((m >> position[i]) & 1) << i;
+    truth |= ((cut.truth >> sub) & 1) << m;
+  }
+  return truth;
+}
+
+/**
+ * @brief Removes the leaves the truth table does not depend on.
+ * Unused leaf positions stay don't-cares (the table is replicated over them).
+ */
+void Shrink(Cut& cut) {
+  for (int i = cut.size - 1; i >= 0; --i) {
+    const int shift = 1 << i;
+    const uint16_t set = cut.truth & kLeafTruth[i];
+    const uint16_t clear = cut.truth & ~kLeafTruth[i];
+    if ((set >> shift) != clear) continue;  // depends on leaf i
+
+    uint16_t truth = 0;
+    for (int m = 0; m < 16; ++m) {
+      // minterm m of the new table is minterm `old` with leaf i cleared
+      const int low = m & 7;
+      const int old = (low & (shift - 1)) | ((low >> i) << (i + 1));
+      truth |= ((cut.truth >> old) & 1) << m;
+    }
+    cut.truth = truth;
+    for (int j = i; j + 1 < cut.size; ++j) cut.leaves[j] = cut.leaves[j + 1];
+    --cut.size;
+  }
+}
+
+/**
+ * @brief Whether the leaves of `a` are a subset of the leaves of `b`.
+ */
+bool Dominates(const Cut& a, const Cut& b) {
+  if (a.size > b.size) return false;
+  for (int i = 0, j = 0; i < a.size; ++i, ++j) {
+    while (j < b.size && b.leaves[j] < a.leaves[i]) ++j;
+    if (j == b.size || b.leaves[j] != a.leaves[i]) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+CutEnumerator::CutEnumerator(const AIG& aig, int cut_size, int max_cuts)
+    : aig_(aig),
+      cut_size_(std::clamp(cut_size, 1, kMaxCutSize)),
+      max_cuts_(std::clamp(max_cuts, 1, 32)) {}
+
+void CutEnumerator::Run(int num_threads) {
+  const int sz_v = aig_.sz_v();
+  cuts_.assign((size_t)sz_v * max_cuts_, Cut());
+  num_cuts_.assign(sz_v, 0);
+
+  auto compute = [&](int v) {
+    Cut& trivial = cuts_[(size_t)v * max_cuts_];
+    trivial.truth = kLeafTruth[0];
+    trivial.size = 1;
+    trivial.leaves[0] = v;
+    num_cuts_[v] = 1;
+    if (v >= aig_.sz_i()) ComputeCuts(v);
+  };
+
+  if (num_threads <= 1) {
+    for (int v = 0; v < sz_v; ++v) compute(v);
+  } else {
+    const auto& offsets = aig_.level_offsets();
+    const auto& vars = aig_.level_vars();
+    const int num_levels = offsets.size() - 1;
+    Barrier barrier(num_threads);
+    RunThreads(num_threads, [&](int thread_id) {
+      for (int l = 0; l < num_levels; ++l) {
+        auto [begin, end] =
+            ThreadRange(offsets[l], offsets[l + 1], thread_id, num_threads);
+        for (int k = begin; k < end; ++k) compute(vars[k]);
+        barrier.Wait();
+      }
+    });
+  }
+
+  total_cuts_ = 0;
+  for (int v = 0; v < sz_v; ++v) total_cuts_ += num_cuts_[v];
+}
+
+void CutEnumerator::ComputeCuts(int variable) {
+  thread_local std::vector<Cut> found;
+  found.clear();
+
+  auto [x, y] = aig_.nodes().inputs[variable * 2];
+  const uint16_t x_negate = (x & 1) ? 0xffff : 0;
+  const uint16_t y_negate = (y & 1) ? 0xffff : 0;
+  for (const Cut& c0 : cuts(x / 2)) {
+    for (const Cut& c1 : cuts(y / 2)) {
+      // union of the sorted leaf sets, give up once it exceeds k
+      Cut cut;
+      int i = 0, j = 0, n = 0;
+      while ((i < c0.size || j < c1.size) && n <= cut_size_) {
+        int leaf;
+        if (j == c1.size || (i < c0.size && c0.leaves[i] < c1.leaves[j])) {
+          leaf = c0.leaves[i++];
+        } else if (i == c0.size || c1.leaves[j] < c0.leaves[i]) {
+          leaf = c1.leaves[j++];
+        } else {
+          leaf = c0.leaves[i++];
+          ++j;
+        }
+        if (n < cut_size_) cut.leaves[n] = leaf;
+        ++n;
+      }
+      if (n > cut_size_) continue;
+      cut.size = n;
+      cut.truth = (Expand(c0, cut.leaves) ^ x_negate) &
+                  (Expand(c1, cut.leaves) ^ y_negate);
+      Shrink(cut);
+      if (cut.size == 0) continue;  // constant, e.g. x & !x
+
+      bool dominated = false;
+      for (const Cut& other : found) {
+        if (Dominates(other, cut)) {
+          dominated = true;
+          break;
+        }
+      }
+      if (dominated) continue;
+      found.erase(std::remove_if(found.begin(), found.end(),
+                                 [&](const Cut& other) {
+                                   return Dominates(cut, other);
+                                 }),
+                  found.end());
+      found.push_back(cut);
+    }
+  }
+
+  // priority: keep the smallest cuts
+  std::stable_sort(found.begin(), found.end(),
+                   [](const Cut& a, const Cut& b) { return a.size < b.size; });
+  Cut* slots = cuts_.data() + (size_t)variable * max_cuts_;
+  int count = 1;  // slot 0 is the trivial cut
+  for (const Cut& cut : found) {
+    if (count == max_cuts_) break;
+    if (cut.size == 1 && cut.leaves[0] == variable) continue;
+    slots[count++] = cut;
+  }
+  num_cuts_[variable] = count;
+}
@@ -0,0 +1,74 @@
+#ifndef SRC_CUT_ENUMERATOR_HH_
+#define SRC_CUT_ENUMERATOR_HH_
+
+#include <cstdint>
+#include <vector>
+
+#include "aig.hh"
+#include "utils.hh"
+
+/**
+ * @brief Priority k-feasible cut enumeration (k <= 4) over an AIG.
+ * Each cut carries its truth table as a 16-bit mask over its leaves, so
+ * callers can match cuts against cell functions.
+ *
+ * Usage example
+```cpp
+CutEnumerator cuts(aig);
+cuts.Run(num_threads);
+for (const auto& cut : cuts.cuts(variable)) { ... }
+```
+ */
+class CutEnumerator {
+ public:
+  static constexpr int kMaxCutSize = 4;
+
+  struct Cut {
+    uint16_t truth;  // minterm m has leaf i set iff bit i of m is set
+    uint8_t size;    // number of leaves
+    int leaves[kMaxCutSize];  // variables, in increasing order
+  };
+
+  /**
+   * @param aig graph to enumerate, levels must be computed when running on
+   * more than one thread (see AIG::ComputeLevels)
+   * @param cut_size max leaves per cut (k), at most kMaxCutSize
+   * @param max_cuts max cuts kept per node, including the trivial cut
+   */
+  CutEnumerator(const AIG& aig, int cut_size = kMaxCutSize, int max_cuts = 8);
+
+  /**
+   * @brief Enumerates cuts for every variable. With more than one thread,
+   * the variables of each logic level are split across the threads.
+   *
+   * @param num_threads
+   */
+  void Run(int num_threads = 1);
+
+  /**
+   * @brief Cuts of `variable`, the trivial cut {variable} comes first.
+   */
+  Span<const Cut> cuts(int variable) const {
+    const Cut* begin = cuts_.data() + (size_t)variable * max_cuts_;
+    return {begin, begin + num_cuts_[variable]};
+  }
+
+  const auto total_cuts() const { return total_cuts_; }
+
+ private:
+  /**
+   * @brief Merges the cuts of the fanins of AND gate `variable`.
+   * Only reads cuts of lower levels, so variables on one level can run
+   * concurrently.
+   */
+  void ComputeCuts(int variable);
+
+  const AIG& aig_;
+  int cut_size_;
+  int max_cuts_;
+  long long total_cuts_ = 0;
+  std::vector<Cut> cuts_;         // max_cuts_ slots per variable
+  std::vector<uint8_t> num_cuts_;  // used slots per variable
+};
+
+#endif  // SRC_CUT_ENUMERATOR_HH_
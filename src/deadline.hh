@@ -0,0 +1,134 @@
+/**
+ * @file deadline.hh
+ * @brief Wall-clock pacing for annealing against a deadline instead of an
+ * iteration count.
+ */
+
+#ifndef SRC_DEADLINE_HH_
+#define SRC_DEADLINE_HH_
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+/**
+ * @brief Maps elapsed time onto the iterations of a temperature schedule, so
+ * that a schedule written for `iterations` iterations is stretched over the
+ * time left until the deadline.
+ *
+ * The clock is read only every `stride` iterations. The stride follows the
+ * measured moves per second so that the clock is read about once per
+ * kCheckPeriod, and between two reads the schedule position is extrapolated
+ * from the same rate.
+ *
+ * Usage example
+```cpp
+const auto now = Deadline::Clock::now();
+Deadline deadline(now, now + std::chrono::seconds(10), 1e5);
+for (long long it = 0; deadline.Tick(it); ++it) {
+  T = schedule(t1, deadline.scheduled(it));
+  ...
+}
+```
+ */
+class Deadline {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * @param begin when the schedule started, the time before it counts as
+   * spent (e.g. before a resume)
+   * @param end when to stop
+   * @param iterations schedule length that the time until `end` is mapped to
+   * @param reserve seconds to stop before `end`, e.g. for writing results.
+   * Called on every clock read, as it may change during the run.
+   */
+  Deadline(Clock::time_point begin, Clock::time_point end, int iterations,
+           std::function<double()> reserve = nullptr)
+      : begin_(begin),
+        end_(end),
+        iterations_(std::max(iterations, 1)),
+        reserve_(std::move(reserve)),
+        last_read_(Clock::now()) {}
+
+  /**
+   * @brief Call once per iteration, with `it` counting up by one (from 0, or
+   * from where a resumed run stopped).
+   *
+   * @return false once the deadline (minus the reserve) has passed
+   */
+  bool Tick(long long it) {
+    if (it < next_read_) return true;
+    const Clock::time_point now = Clock::now();
+    ++clock_reads_;
+    const double reserve = reserve_ ? reserve_() : 0;
+    const double total = Seconds(end_ - begin_) - reserve;
+    const double elapsed = Seconds(now - begin_);
+    if (elapsed >= total) return false;
+
+    const double since = Seconds(now - last_read_);
+    if (clock_reads_ > 1 && it > last_read_it_ && since > 0) {
+      moves_per_second_ = (it - last_read_it_) / since;
+    }
+    base_ = elapsed / total * iterations_;
+    per_move_ = moves_per_second_ > 0
+                    ? iterations_ / (total * moves_per_second_)
+                    : 0;
+    // at most double the stride, one fast move shouldn't set it
+    const double period = std::min(kCheckPeriod, (total - elapsed) / 2);
+    stride_ = std::clamp<long long>(moves_per_second_ * period, 1,
+                                    2 * stride_);
+    last_read_ = now;
+    last_read_it_ = it;
+    next_read_ = it + stride_;
+    return true;
+  }
+
+  /**
+   * @brief Schedule iteration for iteration `it`, the last Tick(). Never
+   * less than the previous one: when the move rate drops, the clock read
+   * lands behind the extrapolation, and the schedule waits there instead of
+   * going back.
+   */
+  int scheduled(long long it) {
+    const double at = base_ + (it - last_read_it_) * per_move_;
+    last_scheduled_ = std::max(
+        last_scheduled_, (int)std::min<double>(at, iterations_ - 1));
+    return last_scheduled_;
+  }
+
+  /**
+   * @brief `seconds` as a Clock duration.
+   */
+  static Clock::duration Duration(double seconds) {
+    return std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(seconds));
+  }
+
+  double moves_per_second() const { return moves_per_second_; }
+  long long clock_reads() const { return clock_reads_; }
+
+ private:
+  static constexpr double kCheckPeriod = 1e-3;  // seconds between reads
+
+  static double Seconds(Clock::duration d) {
+    return std::chrono::duration<double>(d).count();
+  }
+
+  const Clock::time_point begin_;
+  const Clock::time_point end_;
+  const int iterations_;
+  const std::function<double()> reserve_;
+
+  Clock::time_point last_read_;
+  long long last_read_it_ = 0;
+  long long next_read_ = 0;
+  long long stride_ = 1;
+  long long clock_reads_ = 0;
+  double moves_per_second_ = 0;
+  double base_ = 0;      // schedule iteration at the last read
+  double per_move_ = 0;  // schedule iterations per move
+  int last_scheduled_ = 0;
+};
+
+#endif  // SRC_DEADLINE_HH_
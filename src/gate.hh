@@ -23,7 +23,10 @@ class Gate {
   const auto& output() const { return output_; }
   const auto& inputs() const { return inputs_; }
 
-  void set_cell(Cell& cell) { cell_ = &cell; }
+  void set_cell(Cell& cell) {
+    cell_ = &cell;
+    cell_name_ = cell.name();
+  }
 
  private:
   std::string name_, cell_name_;
@@ -0,0 +1,236 @@
+#include "island.hh"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+#include "serialization.hh"
+
+Channel::~Channel() {
+  if (fd_ >= 0) close(fd_);
+}
+
+Channel& Channel::operator=(Channel&& other) {
+  if (this != &other) {
+    if (fd_ >= 0) close(fd_);
+    fd_ = other.fd_;
+    other.fd_ = -1;
+  }
+  return *this;
+}
+
+bool Channel::Send(Type type, const std::string& payload) {
+  if (fd_ < 0 || payload.size() > kMaxPayload) return false;
+  char header[5];
+  const uint32_t size = payload.size();
+  for (int i = 0; i < 4; ++i) header[i] = (char)(size >> (8 * i));
+  header[4] = (char)type;
+  return WriteAll(fd_, header, sizeof(header)) &&
+         WriteAll(fd_, payload.data(), payload.size());
+}
+
+bool Channel::Receive(Type& type, std::string& payload, double timeout) {
+  const auto start = std::chrono::steady_clock::now();
+  char header[5];
+  if (fd_ < 0 || !ReadAll(fd_, header, sizeof(header), timeout)) return false;
+  uint32_t size = 0;
+  for (int i = 0; i < 4; ++i) size |= (uint32_t)(uint8_t)header[i] << (8 * i);
+  if (size > kMaxPayload || (uint8_t)header[4] > (uint8_t)Type::kStop) {
+    return false;
+  }
+  type = (Type)header[4];
+  payload.resize(size);
+  if (timeout >= 0) {
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    timeout = std::max(0.0, timeout - elapsed.count());
+  }
+  return ReadAll(fd_, payload.data(), size, timeout);
+}
+
+namespace {
+
+/**
+ * @brief The coordinator's end of an island.
+ */
+struct Island {
+  Channel channel;
+  int id = 0;
+  std::string report;  // of the current epoch
+  double cost = 0;
+  bool lost = false;
+};
+
+/**
+ * @brief Removes the islands that were lost, so the rest carry on.
+ */
+void DropLost(std::vector<Island>& islands) {
+  for (const Island& island : islands) {
+    if (island.lost) {
+      std::cerr << "[islands] lost island " << island.id << std::endl;
+    }
+  }
+  islands.erase(std::remove_if(islands.begin(), islands.end(),
+                               [](const Island& i) { return i.lost; }),
+                islands.end());
+}
+
+}  // namespace
+
+double RunIslandCoordinator(SimulatedAnnealingMapper& mapper, int listen_fd,
+                            const IslandOptions& options,
+                            const std::filesystem::path& output) {
+  const int n = std::max(options.num_islands, 1);
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<Island> islands;
+  while ((int)islands.size() < n) {
+    double timeout = options.connect_timeout;
+    if (timeout >= 0) {
+      const std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      timeout = std::max(0.0, timeout - elapsed.count());
+    }
+    const int fd = AcceptSocket(listen_fd, timeout);
+    if (fd < 0) break;
+    islands.emplace_back();
+    islands.back().channel = Channel(fd);
+    islands.back().id = islands.size() - 1;
+  }
+  if ((int)islands.size() < n) {
+    std::cerr << "[islands] " << islands.size() << " of " << n
+              << " islands connected" << std::endl;
+  }
+
+  // geometric ladder of starting temperatures, island 0 is the coldest
+  const int m = islands.size();
+  for (Island& island : islands) {
+    IslandAssignment assignment;
+    assignment.island = island.id;
+    assignment.seed = mapper.rng()();
+    assignment.start_temperature =
+        m == 1 ? options.max_temperature
+               : options.min_temperature *
+                     std::pow(options.max_temperature /
+                                  options.min_temperature,
+                              (double)island.id / (m - 1));
+    assignment.end_temperature = options.min_temperature;
+    assignment.epochs = options.epochs;
+    assignment.epoch_iterations = options.epoch_iterations;
+    BinaryWriter ar;
+    ar(assignment);
+    island.lost = !island.channel.Send(Channel::Type::kAssign, ar.buffer());
+  }
+  DropLost(islands);
+
+  double best = std::numeric_limits<double>::infinity();
+  for (int epoch = 0; epoch < options.epochs && !islands.empty(); ++epoch) {
+    // an island that is gone, too slow or malformed is dropped
+    for (Island& island : islands) {
+      Channel::Type type;
+      island.lost = !island.channel.Receive(type, island.report,
+                                            options.report_timeout) ||
+                    type != Channel::Type::kReport;
+      if (island.lost) continue;
+      BinaryReader report(island.report.data(), island.report.size());
+      report(island.cost);
+      island.lost = !report.ok();
+    }
+    DropLost(islands);
+    if (islands.empty()) break;
+
+    const Island& elite = *std::min_element(
+        islands.begin(), islands.end(),
+        [](const Island& a, const Island& b) { return a.cost < b.cost; });
+    if (elite.cost < best) {
+      BinaryReader ar(elite.report.data(), elite.report.size());
+      double cost;
+      ar(cost);
+      if (mapper.DecodeMapping(ar)) {
+        best = cost;
+        std::filesystem::path tmp = output;
+        tmp += ".tmp";
+        mapper.WriteMapping(tmp);
+        std::error_code error;
+        std::filesystem::rename(tmp, output, error);
+      } else {
+        std::cerr << "[islands] malformed mapping from island " << elite.id
+                  << std::endl;
+      }
+    }
+    std::cout << "[islands] epoch=" << std::setw(4) << epoch << std::scientific
+              << " best = " << best << " costs =";
+    for (const Island& island : islands) std::cout << " " << island.cost;
+    std::cout << std::defaultfloat << std::endl;
+
+    // ring migration, the last epoch stops instead
+    if (epoch + 1 == options.epochs) break;
+    for (size_t i = 0; i < islands.size(); ++i) {
+      const Island& from = islands[(i + islands.size() - 1) % islands.size()];
+      islands[i].lost =
+          !islands[i].channel.Send(Channel::Type::kMigrant, from.report);
+    }
+    DropLost(islands);
+  }
+  if (islands.empty()) std::cerr << "[islands] no island left" << std::endl;
+  for (Island& island : islands) island.channel.Send(Channel::Type::kStop, "");
+  return best;
+}
+
+bool RunIslandWorker(
+    SimulatedAnnealingMapper& mapper, const std::string& address,
+    const SimulatedAnnealingMapper::CostEstimator& cost_estimator,
+    const std::vector<SimulatedAnnealingMapper::Transition>& transitions) {
+  Channel coordinator(ConnectSocket(address));
+  Channel::Type type;
+  std::string payload;
+  if (!coordinator.Receive(type, payload) ||
+      type != Channel::Type::kAssign) {
+    return false;
+  }
+  IslandAssignment assignment;
+  {
+    BinaryReader ar(payload.data(), payload.size());
+    ar(assignment);
+    if (!ar.ok()) return false;
+  }
+  mapper.set_seed(assignment.seed);
+  mapper.set_output_path("");
+  mapper.set_checkpoint("");
+  mapper.set_telemetry("");
+
+  // one geometric schedule across all epochs
+  const double total =
+      std::max(1.0, (double)assignment.epochs * assignment.epoch_iterations);
+  int epoch = 0;
+  const auto schedule = [&](double t1, int it) {
+    const double progress =
+        ((double)epoch * assignment.epoch_iterations + it) / total;
+    return t1 * std::pow(assignment.end_temperature / t1, progress);
+  };
+
+  for (epoch = 0; epoch < assignment.epochs; ++epoch) {
+    mapper.Run(schedule, cost_estimator, transitions,
+               assignment.start_temperature, assignment.epoch_iterations);
+    const double cost = cost_estimator(mapper);
+    BinaryWriter ar;
+    ar(cost);
+    mapper.EncodeMapping(ar);
+    if (!coordinator.Send(Channel::Type::kReport, ar.buffer()) ||
+        !coordinator.Receive(type, payload)) {
+      return false;
+    }
+    if (type == Channel::Type::kStop) return true;
+    if (type != Channel::Type::kMigrant) return false;
+
+    BinaryReader migrant(payload.data(), payload.size());
+    double migrant_cost;
+    migrant(migrant_cost);
+    if (migrant_cost < cost && !mapper.DecodeMapping(migrant)) return false;
+  }
+  return coordinator.Receive(type, payload) && type == Channel::Type::kStop;
+}
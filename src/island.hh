@@ -0,0 +1,129 @@
+/**
+ * @file island.hh
+ * @brief Island-model annealing across processes: a coordinator hands out
+ * seeds and schedules to worker processes (islands) that each anneal their
+ * own copy of the design, and migrates mappings between them over stream
+ * sockets. Addresses are "unix:PATH" or "tcp:HOST:PORT", so islands can run
+ * on one machine or, with the design and library at hand, on several.
+ */
+
+#ifndef SRC_ISLAND_HH_
+#define SRC_ISLAND_HH_
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "simulated_annealing_mapper.hh"
+#include "socket.hh"
+
+/**
+ * @brief A connected stream socket carrying framed messages: a 4 byte
+ * little-endian payload length, a 1 byte type, then the payload. Payloads are
+ * archives (serialization.hh), which store numbers little-endian as well, so
+ * islands may run on machines of either byte order. Closes the socket when
+ * destroyed.
+ */
+class Channel {
+ public:
+  enum class Type : uint8_t {
+    kAssign,   // coordinator -> island: IslandAssignment
+    kReport,   // island -> coordinator: cost, then EncodeMapping()
+    kMigrant,  // coordinator -> island: cost, then EncodeMapping()
+    kStop,     // coordinator -> island: empty
+  };
+
+  explicit Channel(int fd = -1) : fd_(fd) {}
+  ~Channel();
+  Channel(Channel&& other) : fd_(other.fd_) { other.fd_ = -1; }
+  Channel& operator=(Channel&& other);
+  Channel(const Channel&) = delete;
+  Channel& operator=(const Channel&) = delete;
+
+  bool ok() const { return fd_ >= 0; }
+
+  /**
+   * @return false if the peer is gone
+   */
+  bool Send(Type type, const std::string& payload);
+
+  /**
+   * @brief Blocks until a whole message arrived.
+   *
+   * @param timeout seconds to wait for it, forever if negative
+   * @return false if the peer is gone, the time is up or the message is
+   * malformed
+   */
+  bool Receive(Type& type, std::string& payload, double timeout = -1);
+
+ private:
+  static constexpr uint32_t kMaxPayload = 1u << 30;
+
+  int fd_;
+};
+
+/**
+ * @brief What the coordinator tells an island to do.
+ */
+struct IslandAssignment {
+  int island = 0;
+  uint64_t seed = 0;
+  double start_temperature = 1;  // cools geometrically from this..
+  double end_temperature = 1e-3;  // ..to this over all epochs
+  int epochs = 1;
+  int epoch_iterations = 0;
+
+  template <class Archive>
+  void Serialize(Archive& ar) {
+    ar(island, seed, start_temperature, end_temperature, epochs,
+       epoch_iterations);
+  }
+};
+
+struct IslandOptions {
+  int num_islands = 4;
+  int epochs = 20;                 // migrations happen between epochs
+  int epoch_iterations = 100000;   // per island
+  double min_temperature = 1e-3;   // all islands end here
+  double max_temperature = 1;      // starting temperature of the hottest
+  // seconds, negative waits forever
+  double connect_timeout = 60;  // for all islands to connect
+  double report_timeout = 600;  // for each island's report of an epoch
+};
+
+/**
+ * @brief Coordinates `options.num_islands` islands connecting to
+ * `listen_fd`. Island i starts at the i-th temperature of a geometric ladder
+ * from `min_temperature` to `max_temperature` with a seed drawn from
+ * mapper.rng(). After every epoch each island reports its mapping, and
+ * island i is sent the mapping of island i - 1 (a ring), which it adopts if
+ * it is better than its own. The best reported mapping is written to
+ * `output` whenever it improves, and `mapper` holds it at the end.
+ *
+ * Islands that don't connect within `connect_timeout`, miss the
+ * `report_timeout` of an epoch or disconnect are dropped, and the ring
+ * closes over the remaining ones. The run stops early only if none is left.
+ *
+ * @param mapper loaded and initialized with the islands' design and library
+ * @return lowest cost reported, infinity if no island reported
+ */
+double RunIslandCoordinator(SimulatedAnnealingMapper& mapper, int listen_fd,
+                            const IslandOptions& options,
+                            const std::filesystem::path& output);
+
+/**
+ * @brief Runs an island: connects to the coordinator at `address` and
+ * anneals as assigned, exchanging mappings between epochs, until it is
+ * stopped. The island doesn't write an output, checkpoints or telemetry.
+ *
+ * @param mapper loaded and initialized with the coordinator's design and
+ * library
+ * @return false if the coordinator was lost or sent something malformed
+ */
+bool RunIslandWorker(
+    SimulatedAnnealingMapper& mapper, const std::string& address,
+    const SimulatedAnnealingMapper::CostEstimator& cost_estimator,
+    const std::vector<SimulatedAnnealingMapper::Transition>& transitions);
+
+#endif  // SRC_ISLAND_HH_
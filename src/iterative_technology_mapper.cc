@@ -1,12 +1,64 @@
 #include "iterative_technology_mapper.hh"
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 
+#include "cut_enumerator.hh"
+#include "serialization.hh"
 #include "utils.hh"
 
 void IterativeTechnologyMapper::WriteMapping(
     const std::filesystem::path& file) const {
+  MappingSnapshot snapshot;
+  GatherMapping(snapshot);
+  WriteMapping(file, snapshot);
+}
+
+void IterativeTechnologyMapper::GatherMapping(
+    MappingSnapshot& snapshot) const {
+  snapshot.cells.resize(sz_v_ * 2);
+  for (int i = 0; i < sz_v_ * 2; ++i) {
+    const auto& aig_node = aig_nodes_[i];
+    snapshot.cells[i] = aig_node.active ? aig_node.cell : Cell::kNoId;
+  }
+  snapshot.gates.clear();
+  for (const auto& gate : gates_) {
+    if (gate.active) snapshot.gates.push_back(gate);
+  }
+}
+
+void IterativeTechnologyMapper::UndoJournal(std::vector<uint64_t>& redo) {
+  redo.resize(journal_.size());
+  for (size_t k = 0; k < journal_.size(); ++k) {
+    std::memcpy(&redo[k], journal_[k].field, journal_[k].size);
+  }
+  for (auto it = journal_.rbegin(); it != journal_.rend(); ++it) {
+    std::memcpy(it->field, &it->old_value, it->size);
+  }
+}
+
+void IterativeTechnologyMapper::RedoJournal(
+    const std::vector<uint64_t>& redo) {
+  for (size_t k = 0; k < journal_.size(); ++k) {
+    std::memcpy(journal_[k].field, &redo[k], journal_[k].size);
+  }
+}
+
+void IterativeTechnologyMapper::CaptureMapping(MappingSnapshot& snapshot) {
+  // undo the open transaction in place, copy, then redo it
+  std::vector<uint64_t> redo;
+  UndoJournal(redo);
+  GatherMapping(snapshot);
+  RedoJournal(redo);
+}
+
+void IterativeTechnologyMapper::WriteMapping(
+    const std::filesystem::path& file, const MappingSnapshot& snapshot) const {
   std::ofstream fout(file);
   std::string module = top_module_name_;
   fout << "module " << module.c_str() << "\n";
@@ -36,29 +88,28 @@ void IterativeTechnologyMapper::WriteMapping(
 
   int gate_id = 0;
   for (int i = 0; i < sz_v_ * 2; ++i) {
-    const auto& node = nodes_[i];
-    const auto& aig_node = aig_nodes_[i];
-    if (aig_node.active) {
-      fout << "\t" << aig_node.cell->name() << " g" << (gate_id++) << " ( ";
+    const auto& inputs = nodes_.inputs[i];
+    const Cell::Id cell = snapshot.cells[i];
+    if (cell != Cell::kNoId) {
+      fout << "\t" << library_.cell(cell).name() << " g" << (gate_id++)
+           << " ( ";
       if (i & 1) {  // NOT gate (from AIG)
         fout << net_names_[i ^ 1] << " , ";
       } else {  // AND gate (from AIG)
-        fout << net_names_[node.inputs[0]] << " , ";
-        fout << net_names_[node.inputs[1]] << " , ";
+        fout << net_names_[inputs[0]] << " , ";
+        fout << net_names_[inputs[1]] << " , ";
       }
       fout << net_names_[i] << " ) ;";
       fout << "\n";
     }
   }
-  for (int i = 0; i < sz_v_ * 2; ++i) {
-    const auto& gate = gates_[i];
-    if (gate.active) {
-      fout << "\t" << gate.cell->name() << " h" << (gate_id++) << " ( ";
-      fout << net_names_[gate.a] << " , ";
-      fout << net_names_[gate.b] << " , ";
-      fout << net_names_[gate.y] << " ) ;";
-      fout << "\n";
-    }
+  for (const auto& gate : snapshot.gates) {
+    fout << "\t" << library_.cell(gate.cell).name() << " h" << (gate_id++)
+         << " ( ";
+    fout << net_names_[gate.a] << " , ";
+    fout << net_names_[gate.b] << " , ";
+    fout << net_names_[gate.y] << " ) ;";
+    fout << "\n";
   }
 
   fout << "endmodule\n";
@@ -115,10 +166,10 @@ void IterativeTechnologyMapper::WriteVerilogABC(
 
   int gate_id = 0;
   for (int i = 0; i < sz_v_ * 2; ++i) {
-    const auto& node = nodes_[i];
+    const auto& inputs = nodes_.inputs[i];
     const auto& aig_node = aig_nodes_[i];
     if (aig_node.active) {
-      std::string name = aig_node.cell->name();
+      std::string name = library_.cell(aig_node.cell).name();
       while (name.back() != '_') name.pop_back();
       name.pop_back();
       fout << "\t" << name << " ( ";
@@ -126,8 +177,8 @@ void IterativeTechnologyMapper::WriteVerilogABC(
       if (i & 1) {  // NOT gate (from AIG)
         fout << net_names_[i ^ 1];
       } else {  // AND gate (from AIG)
-        fout << net_names_[node.inputs[0]] << " , ";
-        fout << net_names_[node.inputs[1]];
+        fout << net_names_[inputs[0]] << " , ";
+        fout << net_names_[inputs[1]];
       }
       fout << " ) ;";
       fout << "\n";
@@ -139,7 +190,7 @@ void IterativeTechnologyMapper::WriteVerilogABC(
   for (int i = 0; i < sz_v_ * 2; ++i) {
     const auto& gate = gates_[i];
     if (gate.active) {
-      std::string name = gate.cell->name();
+      std::string name = library_.cell(gate.cell).name();
       while (name.back() != '_') name.pop_back();
       name.pop_back();
       fout << "\t" << name << " ( ";
@@ -158,21 +209,420 @@ void IterativeTechnologyMapper::LoadLibrary(const std::filesystem::path& file) {
   library_.Load(file);
 }
 
-void IterativeTechnologyMapper::Initialize() {
+namespace {
+
+constexpr char kSnapshotMagic[8] = {'I', 'T', 'M', 'S', 'N', 'A', 'P', 0};
+
+}  // namespace
+
+void IterativeTechnologyMapper::LoadCached(
+    const std::filesystem::path& design, const std::filesystem::path& library,
+    const std::filesystem::path& snapshot) {
+  // the probabilities in the snapshot depend on how they were computed
+  const uint64_t source_hash = HashFile(
+      design, HashFile(library, kSnapshotVersion) ^ simulation_patterns());
+  if (LoadSnapshot(snapshot, source_hash)) {
+    std::cout << "[load] snapshot " << snapshot << std::endl;
+    return;
+  }
+  LoadLibrary(library);
+  Load(design);
   FindPrimitives();
+  if (!SaveSnapshot(snapshot, source_hash)) {
+    std::cerr << "[load] failed to write snapshot " << snapshot << std::endl;
+  }
+}
 
-  aig_nodes_.assign(sz_v_ * 2, AIGAuxiliary());
-  aig_gates_.assign(sz_v_ * 2, GateAuxiliary());
+bool IterativeTechnologyMapper::SaveSnapshot(const std::filesystem::path& file,
+                                             uint64_t source_hash) const {
+  assert(primitives_found_ && "Snapshot is taken after FindPrimitives.");
+  BinaryWriter ar;
+  ar(kSnapshotMagic, kSnapshotVersion, source_hash);
+  ar(sz_v_, sz_i_, sz_o_, sz_a_, inputs_, outputs_, top_module_name_,
+     net_names_, nodes_, fanout_offsets_, fanout_targets_);
+  ar(library_, *candidates_);
+  return ar.Save(file);
+}
+
+bool IterativeTechnologyMapper::LoadSnapshot(const std::filesystem::path& file,
+                                             uint64_t source_hash) {
+  MappedFile mapped(file);
+  if (mapped.empty()) return false;
+  BinaryReader ar(mapped.data(), mapped.size());
+  char magic[sizeof(kSnapshotMagic)];
+  uint32_t version = 0;
+  uint64_t hash = 0;
+  ar(magic, version, hash);
+  if (!ar.ok() || std::memcmp(magic, kSnapshotMagic, sizeof(magic)) != 0 ||
+      version != kSnapshotVersion || hash != source_hash) {
+    return false;
+  }
+  ar(sz_v_, sz_i_, sz_o_, sz_a_, inputs_, outputs_, top_module_name_,
+     net_names_, nodes_, fanout_offsets_, fanout_targets_);
+  std::vector<GateMapping> candidates;
+  ar(library_, candidates);
+  if (!ar.ok() || !ar.at_end()) {  // truncated, start over from sources
+    net_names_.clear();
+    library_ = Library();
+    return false;
+  }
+  candidates_ = std::make_shared<const std::vector<GateMapping>>(
+      std::move(candidates));
+  gates_.assign(sz_v_ * 2, Gate());
+  primitives_found_ = true;
+  return true;
+}
+
+void IterativeTechnologyMapper::SaveState(BinaryWriter& ar) const {
+  assert(!in_transaction_ && "State is saved between transactions.");
+  // gate mappings as indices into candidates_, -1 for none
+  std::vector<int> mappings(aig_gates_.size(), -1);
+  for (size_t g = 0; g < aig_gates_.size(); ++g) {
+    if (aig_gates_[g].mapping) {
+      mappings[g] = aig_gates_[g].mapping - candidates_->data();
+    }
+  }
+  ar((uint64_t)gates_.size(), (uint64_t)candidates_->size());
+  ar(rng_, area_, power_, dynamic_power_, aig_nodes_, gates_, mappings);
+  ar(free_slots_, num_free_slots_, active_gates_, active_position_,
+     num_active_gates_, added_gates_, clock_period_, timing_enabled_);
+}
+
+bool IterativeTechnologyMapper::LoadState(BinaryReader& ar) {
+  assert(!in_transaction_ && "State is loaded between transactions.");
+  uint64_t num_gates = 0, num_candidates = 0;
+  ar(num_gates, num_candidates);
+  if (!ar.ok() || num_gates != gates_.size() ||
+      num_candidates != candidates_->size()) {
+    return false;
+  }
+  // read into locals and range-check everything the mapper indexes with, so
+  // that a corrupt checkpoint leaves the state as it was
+  Random rng;
+  double area, power, dynamic_power, clock_period;
+  std::vector<AIGAuxiliary> aig_nodes;
+  std::vector<Gate> gates;
+  std::vector<int> mappings, free_slots, active_gates, active_position,
+      added_gates;
+  int num_free_slots, num_active_gates;
+  bool timing_enabled;
+  ar(rng, area, power, dynamic_power, aig_nodes, gates, mappings);
+  ar(free_slots, num_free_slots, active_gates, active_position,
+     num_active_gates, added_gates, clock_period, timing_enabled);
+  if (!ar.ok() || aig_nodes.size() != num_gates ||
+      gates.size() != num_gates || mappings.size() != num_gates ||
+      free_slots.size() != num_gates || active_gates.size() != num_gates ||
+      active_position.size() != num_gates || num_free_slots < 0 ||
+      num_free_slots > (int)num_gates || num_active_gates < 0 ||
+      num_active_gates > (int)num_gates) {
+    return false;
+  }
+  const auto gate_id = [&](int g) { return g >= 0 && g < (int)num_gates; };
+  const auto cell_id = [&](Cell::Id cell) { return cell < library_.size(); };
+  for (int k = 0; k < num_free_slots; ++k) {
+    if (!gate_id(free_slots[k])) return false;
+  }
+  for (int k = 0; k < num_active_gates; ++k) {
+    const int g = active_gates[k];
+    if (!gate_id(g) || active_position[g] != k || !gates[g].active ||
+        !cell_id(gates[g].cell) || mappings[g] == -1) {
+      return false;
+    }
+    const bool unary =
+        library_.cell(gates[g].cell).type() & Cell::Type::kMaskUnary;
+    if (!gate_id(gates[g].a) || !gate_id(gates[g].y) ||
+        (!unary && !gate_id(gates[g].b))) {
+      return false;
+    }
+  }
+  for (int g : added_gates) {
+    if (g != -1 && !gate_id(g)) return false;  // -1 records a failed add
+  }
+  for (const AIGAuxiliary& node : aig_nodes) {
+    if ((node.cell != Cell::kNoId && !cell_id(node.cell)) ||
+        (node.covered_by != -1 && !gate_id(node.covered_by))) {
+      return false;
+    }
+  }
+  for (int mapping : mappings) {
+    if (mapping < -1 || mapping >= (int)num_candidates) return false;
+  }
+
+  rng_ = rng;
+  area_ = area;
+  power_ = power;
+  dynamic_power_ = dynamic_power;
+  aig_nodes_ = std::move(aig_nodes);
+  gates_ = std::move(gates);
+  free_slots_ = std::move(free_slots);
+  num_free_slots_ = num_free_slots;
+  active_gates_ = std::move(active_gates);
+  active_position_ = std::move(active_position);
+  num_active_gates_ = num_active_gates;
+  added_gates_ = std::move(added_gates);
+  clock_period_ = clock_period;
+  timing_enabled_ = timing_enabled;
+  for (size_t g = 0; g < num_gates; ++g) {
+    aig_gates_[g].mapping =
+        mappings[g] == -1 ? nullptr : &(*candidates_)[mappings[g]];
+  }
+  if (timing_enabled_) EnableTiming();
+  return true;
+}
+
+void IterativeTechnologyMapper::EncodeMapping(BinaryWriter& ar) {
+  std::vector<uint64_t> redo;
+  UndoJournal(redo);  // the committed mapping, as in CaptureMapping
+  std::vector<Cell::Id> cells(aig_nodes_.size());
+  for (size_t i = 0; i < aig_nodes_.size(); ++i) cells[i] = aig_nodes_[i].cell;
+
+  // gates in reverse output order: covering a node removes the gates it
+  // leaves unused, which decoding must add only after their consumers
+  std::vector<int> order(active_gates_.begin(),
+                         active_gates_.begin() + num_active_gates_);
+  std::sort(order.begin(), order.end(),
+            [&](int g, int h) { return gates_[g].y > gates_[h].y; });
+  std::vector<uint32_t> gate_candidates(order.size());
+  std::vector<Cell::Id> gate_cells(order.size());
+  for (size_t k = 0; k < order.size(); ++k) {
+    gate_candidates[k] = aig_gates_[order[k]].mapping - candidates_->data();
+    gate_cells[k] = gates_[order[k]].cell;
+  }
+  RedoJournal(redo);
+  ar(cells, gate_candidates, gate_cells);
+}
+
+bool IterativeTechnologyMapper::DecodeMapping(BinaryReader& ar) {
+  assert(!in_transaction_ && "Mappings are decoded between transactions.");
+  std::vector<Cell::Id> cells, gate_cells;
+  std::vector<uint32_t> gate_candidates;
+  ar(cells, gate_candidates, gate_cells);
+  if (!ar.ok() || cells.size() != aig_nodes_.size() ||
+      gate_candidates.size() != gate_cells.size()) {
+    return false;
+  }
+  const auto valid = [&](Cell::Id cell) { return cell < library_.size(); };
+  for (Cell::Id cell : cells) {
+    if (cell != Cell::kNoId && !valid(cell)) return false;
+  }
+  for (size_t k = 0; k < gate_cells.size(); ++k) {
+    if (gate_candidates[k] >= candidates_->size() || !valid(gate_cells[k])) {
+      return false;
+    }
+  }
+
+  const bool timing = timing_enabled_;
+  ResetMapping(cells);
+  for (size_t k = 0; k < gate_cells.size(); ++k) {
+    const GateMapping* mapping = &(*candidates_)[gate_candidates[k]];
+    if (AddBinaryGate(mapping, gate_cells[k]) == -1) return false;
+  }
+  if (timing) EnableTiming();
+  return true;
+}
+
+/**
+ * @brief Cascade state that writes straight into the mapper, through Set()
+ * so open transactions journal it.
+ */
+struct IterativeTechnologyMapper::DirectState {
+  IterativeTechnologyMapper& m;
+
+  const AIGAuxiliary& node(int v) const { return m.aig_nodes_[v]; }
+  void set_active(int v, bool x) {
+    m.Set(m.aig_nodes_[v].active, x);
+    MarkDriverChanged(v);
+  }
+  void set_covered_by(int v, int g) {
+    m.Set(m.aig_nodes_[v].covered_by, g);
+    if (m.timing_enabled_) m.MarkArrival(v);
+  }
+  void set_deps(int v, int x) { m.Set(m.aig_nodes_[v].deps, x); }
+  void set_cell(int v, Cell::Id c) {
+    m.Set(m.aig_nodes_[v].cell, c);
+    MarkDriverChanged(v);
+  }
+
+  // the AIG gate driving v changed, so does v's arrival and what it reads
+  void MarkDriverChanged(int v) {
+    if (!m.timing_enabled_) return;
+    m.MarkArrival(v);
+    if (v & 1) {
+      m.MarkRequired(v ^ 1);
+    } else if (v / 2 >= m.sz_i_) {
+      for (int x : m.nodes_.inputs[v]) m.MarkRequired(x);
+    }
+  }
+
+  const Gate& gate(int g) const { return m.gates_[g]; }
+
+  int AllocateGate(const GateMapping* mapping, Cell::Id cell) {
+    if (m.num_free_slots_ == 0) return -1;
+    const int gate_id = m.free_slots_[m.num_free_slots_ - 1];
+    m.Set(m.num_free_slots_, m.num_free_slots_ - 1);
+    m.Set(m.active_gates_[m.num_active_gates_], gate_id);
+    m.Set(m.active_position_[gate_id], m.num_active_gates_);
+    m.Set(m.num_active_gates_, m.num_active_gates_ + 1);
+
+    auto& gate = m.gates_[gate_id];
+    m.Set(gate.active, true);
+    m.Set(gate.cell, cell);
+    m.Set(gate.a, mapping->a);
+    m.Set(gate.b, mapping->b);
+    m.Set(gate.y, mapping->y);
+    m.Set(m.aig_gates_[gate_id].mapping, mapping);
+    if (m.timing_enabled_) {
+      m.MarkArrival(mapping->y);
+      m.MarkRequired(mapping->a);
+      m.MarkRequired(mapping->b);
+    }
+    return gate_id;
+  }
+
+  void FreeGate(int gate_id) {
+    const auto& gate = m.gates_[gate_id];
+    if (m.timing_enabled_) {
+      m.MarkArrival(gate.y);
+      m.MarkRequired(gate.a);
+      m.MarkRequired(gate.b);
+    }
+
+    // the last active gate takes over the freed position
+    m.Set(m.gates_[gate_id].active, false);
+    m.Set(m.aig_gates_[gate_id].mapping, (const GateMapping*)nullptr);
+    const int position = m.active_position_[gate_id];
+    const int last = m.active_gates_[m.num_active_gates_ - 1];
+    m.Set(m.active_gates_[position], last);
+    m.Set(m.active_position_[last], position);
+    m.Set(m.active_position_[gate_id], -1);
+    m.Set(m.num_active_gates_, m.num_active_gates_ - 1);
+    m.Set(m.free_slots_[m.num_free_slots_], gate_id);
+    m.Set(m.num_free_slots_, m.num_free_slots_ + 1);
+  }
+
+  void AddStats(double area, double power, double dynamic_power) {
+    m.area_ += area;
+    m.power_ += power;
+    m.dynamic_power_ += dynamic_power;
+  }
+};
+
+/**
+ * @brief Read-only cascade state. Writes land in the mapper's shadow arrays
+ * (valid for the current epoch only) and the stats in `delta`, so the mapper
+ * itself is never modified. One overlay may be alive at a time.
+ */
+struct IterativeTechnologyMapper::OverlayState {
+  const IterativeTechnologyMapper& m;
+  Stats delta;
+  Gate added;  // the gate allocated by this query, if any
+  Gate freed;  // what gate() returns for gates removed by this query
+
+  explicit OverlayState(const IterativeTechnologyMapper& mapper) : m(mapper) {
+    if (++m.shadow_epoch_ == 0) {  // wrapped around, invalidate everything
+      std::fill(m.shadow_stamp_.begin(), m.shadow_stamp_.end(), 0);
+      std::fill(m.freed_stamp_.begin(), m.freed_stamp_.end(), 0);
+      m.shadow_epoch_ = 1;
+    }
+  }
+
+  const AIGAuxiliary& node(int v) const {
+    if (m.shadow_stamp_[v] == m.shadow_epoch_) return m.shadow_nodes_[v];
+    return m.aig_nodes_[v];
+  }
+  AIGAuxiliary& Touch(int v) {
+    if (m.shadow_stamp_[v] != m.shadow_epoch_) {
+      m.shadow_stamp_[v] = m.shadow_epoch_;
+      m.shadow_nodes_[v] = m.aig_nodes_[v];
+    }
+    return m.shadow_nodes_[v];
+  }
+  void set_active(int v, bool x) { Touch(v).active = x; }
+  void set_covered_by(int v, int g) { Touch(v).covered_by = g; }
+  void set_deps(int v, int x) { Touch(v).deps = x; }
+  void set_cell(int v, Cell::Id c) { Touch(v).cell = c; }
+
+  int added_id() const { return m.gates_.size(); }  // past the real slots
+
+  const Gate& gate(int g) const {
+    if (g == added_id()) return added;
+    if (m.freed_stamp_[g] == m.shadow_epoch_) return freed;
+    return m.gates_[g];
+  }
+
+  int AllocateGate(const GateMapping* mapping, Cell::Id cell) {
+    if (m.num_free_slots_ == 0) return -1;
+    added.active = true;
+    added.cell = cell;
+    added.a = mapping->a;
+    added.b = mapping->b;
+    added.y = mapping->y;
+    return added_id();
+  }
+
+  void FreeGate(int gate_id) {
+    if (gate_id == added_id()) {
+      added.active = false;
+    } else {
+      m.freed_stamp_[gate_id] = m.shadow_epoch_;
+    }
+  }
+
+  void AddStats(double area, double power, double dynamic_power) {
+    delta.area += area;
+    delta.power += power;
+    delta.dynamic_power += dynamic_power;
+  }
+};
+
+void IterativeTechnologyMapper::Initialize() {
+  if (!primitives_found_) FindPrimitives();
 
   // set default cells
+  std::vector<Cell::Id> cells(sz_v_ * 2, Cell::kNoId);
   const auto cell_a = library_.GetCellsByType(Cell::Type::kAnd);
   const auto cell_i = library_.GetCellsByType(Cell::Type::kNot);
-  for (int i = sz_i_; i < sz_v_; ++i) aig_nodes_[i * 2].cell = choice(cell_a);
-  for (int i = 0; i < sz_v_; ++i) aig_nodes_[i * 2 + 1].cell = choice(cell_i);
+  for (int i = sz_i_; i < sz_v_; ++i) {
+    cells[i * 2] = choice(cell_a, rng_);
+  }
+  for (int i = 0; i < sz_v_; ++i) {
+    cells[i * 2 + 1] = choice(cell_i, rng_);
+  }
+  ResetMapping(cells);
+}
+
+void IterativeTechnologyMapper::ResetMapping(
+    const std::vector<Cell::Id>& cells) {
+  aig_nodes_.assign(sz_v_ * 2, AIGAuxiliary());
+  for (int i = 0; i < sz_v_ * 2; ++i) aig_nodes_[i].cell = cells[i];
+  aig_gates_.assign(sz_v_ * 2, GateAuxiliary());
+  gates_.assign(gates_.size(), Gate());
+
+  // every gate slot starts free, lowest ids on top of the stack
+  const int num_slots = gates_.size();
+  free_slots_.resize(num_slots);
+  for (int i = 0; i < num_slots; ++i) free_slots_[i] = num_slots - 1 - i;
+  num_free_slots_ = num_slots;
+  active_gates_.assign(num_slots, -1);
+  active_position_.assign(num_slots, -1);
+  num_active_gates_ = 0;
+  added_gates_.clear();
+  area_ = power_ = dynamic_power_ = 0;
+
+  // scratch space for the delta queries
+  shadow_nodes_.assign(aig_nodes_.size(), AIGAuxiliary());
+  shadow_stamp_.assign(aig_nodes_.size(), 0);
+  freed_stamp_.assign(gates_.size(), 0);
+  shadow_epoch_ = 0;
+
+  // clock period is the first number encoded in the module name
+  std::istringstream(DecodeModuleName(top_module_name_, 1)) >> clock_period_;
+  timing_enabled_ = false;
 
   // handle I/O dependencies
-  for (int i : inputs_) AddDependency(i);
-  for (int i : outputs_) AddDependency(i);
+  DirectState state{*this};
+  for (int i : inputs_) AddDependency(state, i);
+  for (int i : outputs_) AddDependency(state, i);
 
   // you don't count these here initially because the AIG
   // is initially completely inactive -- only adding the outputs_ will
@@ -187,7 +637,7 @@ void IterativeTechnologyMapper::Initialize() {
   // handle AND gate dependencies
   // for (int i = sz_i_; i < sz_v_; ++i) {
   //   // (a) + (b) ---AND---> (i*2)
-  //   for (auto inp : nodes_[i * 2].inputs) AddDependency(inp);
+  //   for (auto inp : nodes_.inputs[i * 2]) AddDependency(inp);
   // }
 
   // for (int i = 0; i < sz_v_*2; ++i) {
@@ -198,111 +648,82 @@ void IterativeTechnologyMapper::Initialize() {
 }
 
 void IterativeTechnologyMapper::FindPrimitives() {
-  int and_ct = 0, nand_ct = 0;
-  int nor_ct = 0, or_ct = 0;
-  int xor_ct = 0, xnor_ct = 0;
+  auto t0 = std::chrono::steady_clock::now();
+
+  if (num_threads_ > 1) ComputeLevels();
+  CutEnumerator enumerator(*this);
+  enumerator.Run(num_threads_);
+
+  auto t1 = std::chrono::steady_clock::now();
+
+  /**
+   * 2-input cell functions as 4-bit truth tables, minterm m = a + 2b.
+   * A cut {l0, l1} of AND gate z with truth table t is implemented by
+   * cell(l0 ^ pa, l1 ^ pb) if the cell's function with its inputs inverted
+   * by (pa, pb) equals t (output z), or !t (output z + 1 -- the INV node).
+   */
+  static constexpr std::pair<Cell::Type, int> kFunctions[] = {
+      {Cell::Type::kAnd, 0x8}, {Cell::Type::kNand, 0x7},
+      {Cell::Type::kOr, 0xe},  {Cell::Type::kNor, 0x1},
+      {Cell::Type::kXor, 0x6}, {Cell::Type::kXnor, 0x9},
+  };
+  std::vector<std::pair<Cell::Type, int>> functions;
+  for (auto [type, truth] : kFunctions) {
+    if (!library_.GetCellsByType(type).empty()) {
+      functions.push_back({type, truth});
+    }
+  }
+
+  std::vector<GateMapping> candidates;
   for (int i = sz_i_; i < sz_v_; ++i) {
-    const auto& AND = nodes_[i * 2];
-    const auto& NAND = nodes_[i * 2 + 1];
-    auto [x, y] = AND.inputs;
     const int z = i * 2;
     const int znot = i * 2 + 1;
-
-    bool set_read = AND.out_degree;   // does the AND get read?
-    bool inv_read = NAND.out_degree;  // does the NAND get read?
-    and_ct += set_read;
-    nand_ct += inv_read;
-    // candidates_.push_back(GateMapping(x, y, z, Cell::Type::kAnd));
-    if (inv_read) {
-      candidates_.push_back(GateMapping(x, y, znot, Cell::Type::kNand));
-    }
-
-    // ensure both x,y are INV nodes
-    if (x & y & 1) {
-      // change from INV node to the AND node
-      x ^= 1;
-      y ^= 1;
-
-      /**
-       * nor takes the form
-       *
-       * NOR = !x !y
-       */
-      // if both are inverted inputs
-      ++nor_ct;
-      candidates_.push_back(GateMapping(x, y, z, Cell::Type::kNor));
-
-      if (inv_read) {
-        ++or_ct;
-        candidates_.push_back(GateMapping(x, y, znot, Cell::Type::kOr));
-      }
-
-      /**
-       * xnor takes the form
-       *
-       * XNOR = !a !b
-       * a [AND] = !x y          -- 2x+1   2y
-       * b [AND] = x !y          -- 2x     2y+1
-       */
-      if (nodes_[x].inputs[0] != -1 && nodes_[y].inputs[0] != -1) {
-        // the two inverted inputs to AND are also output of AND
-        auto [x1, y1] = nodes_[x].inputs;
-        auto [x2, y2] = nodes_[y].inputs;
-        // make sure x* <= y* at all times
-        if (x1 > y1) std::swap(x1, y1);
-        if (x2 > y2) std::swap(x2, y2);
-        // x1 and x2 should differ by exactly 1 and come from same literal
-        // y1 and y2 (same relation as x1~x2)
-        // x1 and y1 also need to be different parity!
-        if ((x1 ^ x2) == 1 && (y1 ^ y2) == 1 && (x1 / 2 == x2 / 2) &&
-            (y1 / 2 == y2 / 2) && ((y1 - x1) & 1)) {
-          // *1 will be the non-inverted form
-          // *2 will be the inverted form
-          x1 ^= (x1 & 1);
-          y1 ^= (y1 & 1);
-          x2 = x1 | 1;
-          y2 = y1 | 1;
-          ++xnor_ct;
-          candidates_.push_back(GateMapping(x1, y1, z, Cell::Type::kXnor));
-          candidates_.push_back(GateMapping(x2, y2, z, Cell::Type::kXnor));
-          if (inv_read) {
-            ++xor_ct;
-            candidates_.push_back(GateMapping(x1, y1, znot, Cell::Type::kXor));
-            candidates_.push_back(GateMapping(x2, y2, znot, Cell::Type::kXor));
+    auto [x, y] = nodes_.inputs[z];
+    bool inv_read = nodes_.out_degree[znot];  // does the NAND get read?
+
+    for (const auto& cut : enumerator.cuts(i)) {
+      if (cut.size != 2) continue;
+      const int t = cut.truth & 0xf;
+      for (auto [type, truth] : functions) {
+        for (int pa = 0; pa < 2; ++pa) {
+          for (int pb = 0; pb < 2; ++pb) {
+            int f = 0;  // cell function with inputs inverted by (pa, pb)
+            for (int m = 0; m < 4; ++m) {
+              f |= ((truth >> (m ^ pa ^ (pb << 1))) & 1) << m;
+            }
+            const int a = cut.leaves[0] * 2 + pa;
+            const int b = cut.leaves[1] * 2 + pb;
+            if (f == t) {
+              // skip the AND gate already in the AIG
+              if (type == Cell::Type::kAnd && a == x && b == y) continue;
+              candidates.push_back(GateMapping(a, b, z, type));
+            } else if (f == (~t & 0xf) && inv_read) {
+              candidates.push_back(GateMapping(a, b, znot, type));
+            }
           }
         }
       }
     }
   }
-
-  // printf("and=%i nand=%i or=%i nor=%i xor=%i xnor=%i\n", and_ct, nand_ct,
-  // or_ct, nor_ct, xor_ct, xnor_ct);
-
-  /*
-  // print all candidates
-  for (auto g : candidates_) {
-    std::string type;
-    switch (g.type) {
-      case Cell::Type::kOr:
-        type = "or";
-        break;
-      case Cell::Type::kNor:
-        type = "nor";
-        break;
-      case Cell::Type::kXor:
-        type = "xor";
-        break;
-      case Cell::Type::kXnor:
-        type = "xnor";
-        break;
-    }
-    printf("* %i %s %i => %i\n", g.a, type.c_str(), g.b, g.y);
-  }
-  */
+  candidates_ = std::make_shared<const std::vector<GateMapping>>(
+      std::move(candidates));
+
+  auto t2 = std::chrono::steady_clock::now();
+  using std::chrono::duration;
+  const double cut_ms = duration<double, std::milli>(t1 - t0).count();
+  const double match_ms = duration<double, std::milli>(t2 - t1).count();
+  const int nodes = std::max(1, sz_a_);
+  std::cout << "[cuts] nodes=" << sz_a_
+            << " cuts=" << enumerator.total_cuts() << " ("
+            << (double)enumerator.total_cuts() / nodes << "/node)"
+            << " time=" << cut_ms << "ms (" << cut_ms * 1e3 / nodes
+            << "us/node) match=" << match_ms
+            << "ms candidates=" << candidates_->size() << std::endl;
+  primitives_found_ = true;
 }
 
 void IterativeTechnologyMapper::AddRandomGate() {
-  const auto g_ptr = choice_ptr(candidates_);
+  const auto g_ptr = choice_ptr(*candidates_, rng_);
   int gate_id = -1;
   if (aig_nodes_[g_ptr->y].deps) {
     // make sure something actually gonna read it?
@@ -313,18 +734,120 @@ void IterativeTechnologyMapper::AddRandomGate() {
 
 void IterativeTechnologyMapper::UndoGateAdd() {
   if (!added_gates_.empty()) {
-    if (added_gates_.back() == -1) return;
-    RemoveBinaryGate(added_gates_.back());
+    // -1 is an add that failed, nothing to remove but still pop it
+    if (added_gates_.back() != -1) RemoveBinaryGate(added_gates_.back());
     added_gates_.pop_back();
   }
 }
 
+void IterativeTechnologyMapper::Begin() {
+  assert(!in_transaction_ && "Transactions do not nest.");
+  in_transaction_ = true;
+  journal_.clear();
+  begin_stats_ = {area_, power_, dynamic_power_};
+  begin_added_gates_ = added_gates_.size();
+}
+
+void IterativeTechnologyMapper::Commit() {
+  in_transaction_ = false;
+  journal_.clear();
+
+  // apply the accepted proposal for real, nothing to journal at this point
+  const Proposal proposal = pending_;
+  pending_ = Proposal();
+  switch (proposal.kind) {
+    case Proposal::kNone:
+      break;
+    case Proposal::kAddBinaryGate:
+      added_gates_.push_back(AddBinaryGate(proposal.mapping, proposal.cell));
+      break;
+    case Proposal::kRemoveBinaryGate:
+      RemoveBinaryGate(proposal.target);
+      break;
+    case Proposal::kChangeAIGNodeGate:
+      ChangeAIGNodeGate(proposal.target, proposal.cell);
+      break;
+  }
+}
+
+void IterativeTechnologyMapper::Rollback() {
+  assert(in_transaction_ && "Rollback without Begin.");
+  for (auto it = journal_.rbegin(); it != journal_.rend(); ++it) {
+    std::memcpy(it->field, &it->old_value, it->size);
+  }
+  area_ = begin_stats_.area;
+  power_ = begin_stats_.power;
+  dynamic_power_ = begin_stats_.dynamic_power;
+  // only pushes are undone, UndoGateAdd inside a transaction is not journaled
+  if (added_gates_.size() > begin_added_gates_) {
+    added_gates_.resize(begin_added_gates_);
+  }
+  in_transaction_ = false;
+  journal_.clear();
+  pending_ = Proposal();  // never applied, just drop it
+}
+
+IterativeTechnologyMapper::Stats IterativeTechnologyMapper::DeltaAddBinaryGate(
+    const GateMapping* mapping, Cell::Id cell) const {
+  OverlayState state(*this);
+  AddBinaryGate(state, mapping, cell);
+  return state.delta;
+}
+
+IterativeTechnologyMapper::Stats
+IterativeTechnologyMapper::DeltaRemoveBinaryGate(int gate_id) const {
+  OverlayState state(*this);
+  RemoveBinaryGate(state, gate_id);
+  return state.delta;
+}
+
+IterativeTechnologyMapper::Stats
+IterativeTechnologyMapper::DeltaChangeAIGNodeGate(int aig_variable,
+                                                  Cell::Id new_cell) const {
+  OverlayState state(*this);
+  ChangeAIGNodeGate(state, aig_variable, new_cell);
+  return state.delta;
+}
+
+void IterativeTechnologyMapper::ProposeAddRandomGate() {
+  const auto mapping = choice_ptr(*candidates_, rng_);
+  // make sure something actually gonna read it?
+  if (!aig_nodes_[mapping->y].deps) return;
+  const auto cell = choice(library_.GetCellsByType(mapping->type), rng_);
+  ProposeAddBinaryGate(mapping, cell);
+}
+
+void IterativeTechnologyMapper::ProposeAddBinaryGate(const GateMapping* mapping,
+                                                     Cell::Id cell) {
+  assert(in_transaction_ && pending_.kind == Proposal::kNone);
+  if (timing_enabled_) {
+    added_gates_.push_back(AddBinaryGate(mapping, cell));
+    return;
+  }
+  pending_ = {Proposal::kAddBinaryGate, mapping, cell, -1,
+              DeltaAddBinaryGate(mapping, cell)};
+}
+
+void IterativeTechnologyMapper::ProposeRemoveBinaryGate(int gate_id) {
+  assert(in_transaction_ && pending_.kind == Proposal::kNone);
+  if (timing_enabled_) return RemoveBinaryGate(gate_id);
+  pending_ = {Proposal::kRemoveBinaryGate, nullptr, Cell::kNoId, gate_id,
+              DeltaRemoveBinaryGate(gate_id)};
+}
+
+void IterativeTechnologyMapper::ProposeChangeAIGNodeGate(int aig_variable,
+                                                         Cell::Id new_cell) {
+  assert(in_transaction_ && pending_.kind == Proposal::kNone);
+  if (timing_enabled_) return ChangeAIGNodeGate(aig_variable, new_cell);
+  pending_ = {Proposal::kChangeAIGNodeGate, nullptr, new_cell, aig_variable,
+              DeltaChangeAIGNodeGate(aig_variable, new_cell)};
+}
+
 void IterativeTechnologyMapper::ChangeAIGNodeGate(int aig_variable,
-                                                  const Cell* new_cell) {
-  bool update_aig_node = aig_nodes_[aig_variable].active;
-  if (update_aig_node) CoverAIG(aig_variable);
-  aig_nodes_[aig_variable].cell = new_cell;
-  if (update_aig_node) UncoverAIG(aig_variable);
+                                                  Cell::Id new_cell) {
+  DirectState state{*this};
+  ChangeAIGNodeGate(state, aig_variable, new_cell);
+  if (timing_enabled_) UpdateTiming();
 }
 
 int IterativeTechnologyMapper::AddUnaryGate(const GateMapping& gate) {
@@ -333,161 +856,172 @@ int IterativeTechnologyMapper::AddUnaryGate(const GateMapping& gate) {
 
 void IterativeTechnologyMapper::RemoveUnaryGate(int gate_id) {}
 
-int IterativeTechnologyMapper::AddBinaryGate(const GateMapping* mapping) {
+int IterativeTechnologyMapper::AddBinaryGate(const GateMapping* mapping,
+                                             Cell::Id cell) {
+  // pick a random cell
+  if (cell == Cell::kNoId) {
+    cell = choice(library_.GetCellsByType(mapping->type), rng_);
+  }
+  DirectState state{*this};
+  const int gate_id = AddBinaryGate(state, mapping, cell);
+  if (timing_enabled_) UpdateTiming();
+  return gate_id;
+}
+
+void IterativeTechnologyMapper::RemoveBinaryGate(int gate_id) {
+  DirectState state{*this};
+  RemoveBinaryGate(state, gate_id);
+  if (timing_enabled_) UpdateTiming();
+}
+
+template <class State>
+void IterativeTechnologyMapper::ChangeAIGNodeGate(State& s, int aig_variable,
+                                                  Cell::Id new_cell) const {
+  bool update_aig_node = s.node(aig_variable).active;
+  if (update_aig_node) CoverAIG(s, aig_variable);
+  s.set_cell(aig_variable, new_cell);
+  if (update_aig_node) UncoverAIG(s, aig_variable);
+}
+
+template <class State>
+int IterativeTechnologyMapper::AddBinaryGate(State& s,
+                                             const GateMapping* mapping,
+                                             Cell::Id cell) const {
   // ensure there is no output overlap first
   // remember, **one** driver per net!
   // its a waste for multiple drivers anyways
-  if (aig_nodes_[mapping->y].covered_by != -1) return -1;
+  if (s.node(mapping->y).covered_by != -1) return -1;
 
   // this checks for intermediate overlapping
   // for (auto i : mapping.covers) {
-  //   if (nodes_[i].is_io) return -1;
+  //   if (nodes_.is_io[i]) return -1;
   //   if (aig_nodes_[i].covered_by != -1) return -1;
   // }
 
   // nevermind, i assume SA will figure overlap out
 
-  // find allocation spot
-  static int gate_id = 0;
-  while (gates_[gate_id].active) {
-    ++gate_id;
-    gate_id %= gates_.size();
-  }
-
-  // pick a random cell
-  const auto cell = choice(library_.GetCellsByType(mapping->type));
-
   // allocate
-  auto& gate = gates_[gate_id];
-  gate.active = true;
-  gate.cell = cell;
-  gate.a = mapping->a;
-  gate.b = mapping->b;
-  gate.y = mapping->y;
-  aig_gates_[gate_id].mapping = mapping;
+  const int gate_id = s.AllocateGate(mapping, cell);
+  if (gate_id == -1) return -1;
 
   // update dependencies
-  auto& aig_node = aig_nodes_[gate.y];
-  aig_node.covered_by = gate_id;
+  s.set_covered_by(mapping->y, gate_id);
 
   // you need to add new dependencies of the added gate
-  AddDependency(gate.a);
-  AddDependency(gate.b);
+  AddDependency(s, mapping->a);
+  AddDependency(s, mapping->b);
 
   // you don't need the output node anymore
   // since the new gate fills the role of net driver
-  CoverAIG(gate.y);
+  CoverAIG(s, mapping->y);
 
   // update stats
-  double leak = cell->leakage_power();
-  area_ += cell->area();
-  power_ += leak;
-  dynamic_power_ += leak * nodes_[mapping->y].q;
+  double leak = library_.leakage_power(cell);
+  s.AddStats(library_.area(cell), leak, leak * nodes_.q[mapping->y]);
 
   return gate_id;
 }
 
-void IterativeTechnologyMapper::RemoveBinaryGate(int gate_id) {
-  auto& gate = gates_[gate_id];
-  auto& aig_gate = aig_gates_[gate_id];
+template <class State>
+void IterativeTechnologyMapper::RemoveBinaryGate(State& s, int gate_id) const {
+  const Gate gate = s.gate(gate_id);  // copy, the slot is freed below
   if (!gate.active) return;
-  gate.active = true;
 
   // update dependencies
   // uncover the AIG node since the gate is removed
   // something NEEDS to fill the role of net driver
-  aig_nodes_[gate.y].covered_by = -1;
-  UncoverAIG(gate.y);
+  s.set_covered_by(gate.y, -1);
+  UncoverAIG(s, gate.y);
 
   // and since you removed it... the inputs are no longer there
-  RemoveDependency(gate.a);
-  RemoveDependency(gate.b);
+  RemoveDependency(s, gate.a);
+  RemoveDependency(s, gate.b);
 
   // update stats
   const auto cell = gate.cell;
-  double leak = cell->leakage_power();
-  area_ -= cell->area();
-  power_ -= leak;
-  dynamic_power_ -= leak * nodes_[aig_gate.mapping->y].q;
+  double leak = library_.leakage_power(cell);
+  s.AddStats(-library_.area(cell), -leak, -leak * nodes_.q[gate.y]);
 
   // deallocate
-  gate.active = false;
-  aig_gate.mapping = nullptr;
+  s.FreeGate(gate_id);
 }
 
-void IterativeTechnologyMapper::CoverAIG(int variable) {
+template <class State>
+void IterativeTechnologyMapper::CoverAIG(State& s, int variable) const {
   // printf("cover (-) %i\n", variable);
 
-  auto& aig_node = aig_nodes_[variable];
+  const auto& aig_node = s.node(variable);
   if (!aig_node.active) return;
-  aig_node.active = false;
+  s.set_active(variable, false);
 
-  double leak = aig_node.cell->leakage_power();
-  area_ -= aig_node.cell->area();
-  power_ -= leak;
-  dynamic_power_ -= leak * nodes_[variable].q;
+  const auto cell = aig_node.cell;
+  double leak = library_.leakage_power(cell);
+  s.AddStats(-library_.area(cell), -leak, -leak * nodes_.q[variable]);
 
   // since you are covering the AIG node -- presumbly because either its one
   // dependency has been removed, or that the output gate is being
   // reimplemented by another gate -- in either case, it's old dependencies
   // are no longer needed
   if (variable & 1) {  // INV node
-    RemoveDependency(variable ^ 1);
+    RemoveDependency(s, variable ^ 1);
   } else {  // AND node
-    auto [x, y] = nodes_[variable].inputs;
-    RemoveDependency(x);
-    RemoveDependency(y);
+    auto [x, y] = nodes_.inputs[variable];
+    RemoveDependency(s, x);
+    RemoveDependency(s, y);
   }
 }
 
-void IterativeTechnologyMapper::UncoverAIG(int variable) {
+template <class State>
+void IterativeTechnologyMapper::UncoverAIG(State& s, int variable) const {
   // printf("uncover (+) %i\n", variable);
 
-  auto& aig_node = aig_nodes_[variable];
+  const auto& aig_node = s.node(variable);
   if (aig_node.covered_by != -1) return;  // its output is already covered
   if (aig_node.active) return;
-  aig_node.active = true;
+  s.set_active(variable, true);
 
-  double leak = aig_node.cell->leakage_power();
-  area_ += aig_node.cell->area();
-  power_ += leak;
-  dynamic_power_ += leak * nodes_[variable].q;
+  const auto cell = aig_node.cell;
+  double leak = library_.leakage_power(cell);
+  s.AddStats(library_.area(cell), leak, leak * nodes_.q[variable]);
 
   // since you're uncovering the AIG node to use the default gate,
   // you have additional dependencies now
   if (variable & 1) {  // INV node
-    AddDependency(variable ^ 1);
+    AddDependency(s, variable ^ 1);
   } else {  // AND node
-    auto [x, y] = nodes_[variable].inputs;
-    AddDependency(x);
-    AddDependency(y);
+    auto [x, y] = nodes_.inputs[variable];
+    AddDependency(s, x);
+    AddDependency(s, y);
   }
 }
 
-void IterativeTechnologyMapper::AddDependency(int variable) {
+template <class State>
+void IterativeTechnologyMapper::AddDependency(State& s, int variable) const {
   // printf("++dep %i\n", variable);
-  auto& aig_node = aig_nodes_[variable];
+  s.set_deps(variable, s.node(variable).deps + 1);
 
   // if adding the first dependency, you'll need to uncover it
-  bool first_dependency = ++aig_node.deps == 1;
+  bool first_dependency = s.node(variable).deps == 1;
 
   // make sure its not an input port
   bool input_port = (variable & 1) == 0 && variable / 2 < sz_i_;
 
-  if (first_dependency && !input_port) UncoverAIG(variable);
+  if (first_dependency && !input_port) UncoverAIG(s, variable);
 }
 
-void IterativeTechnologyMapper::RemoveDependency(int variable) {
+template <class State>
+void IterativeTechnologyMapper::RemoveDependency(State& s,
+                                                 int variable) const {
   // printf("--dep %i\n", variable);
-  auto& aig_node = aig_nodes_[variable];
+  s.set_deps(variable, s.node(variable).deps - 1);
 
   // if removing the last dependency, you don't need it anymore
-  bool last_dependency = --aig_node.deps == 0;
-  if (last_dependency) {
+  if (s.node(variable).deps == 0) {
     // if theres a gate that got added, remove it first
-    if (aig_node.covered_by != -1) RemoveBinaryGate(aig_node.covered_by);
+    const int covered_by = s.node(variable).covered_by;
+    if (covered_by != -1) RemoveBinaryGate(s, covered_by);
 
     // and then cover the AIG node
-    CoverAIG(variable);
+    CoverAIG(s, variable);
   }
 }
@@ -1,9 +1,20 @@
 #ifndef SRC_ITERATIVE_TECHNOLOGY_MAPPER_
 #define SRC_ITERATIVE_TECHNOLOGY_MAPPER_
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <type_traits>
+
 #include "aig.hh"
 #include "cell.hh"
 #include "library.hh"
+#include "random.hh"
+
+class BinaryReader;
+class BinaryWriter;
 
 /**
  * @brief Iterative technology mapper for an And-Inverter graph.
@@ -14,6 +25,7 @@ class IterativeTechnologyMapper : public AIG {
   IterativeTechnologyMapper() {}
 
   struct GateMapping {
+    GateMapping() {}
     GateMapping(int a, int b, int y, Cell::Type type)
         : a(a), b(b), y(y), type(type) {}
     int a = -1;       // input A
@@ -23,6 +35,12 @@ class IterativeTechnologyMapper : public AIG {
     // std::vector<int> covers;  // what literals this replaces
   };
 
+  struct Stats {  // cost terms of a mapping, or a change to them
+    double area = 0;
+    double power = 0;
+    double dynamic_power = 0;
+  };
+
   /**
    * @brief Loads the library at the path into the cost function.
    * This should only be called once.
@@ -30,15 +48,129 @@ class IterativeTechnologyMapper : public AIG {
    */
   void LoadLibrary(const std::filesystem::__cxx11::path &file);
 
-  const double area() const { return area_; }
-  const double power() const { return power_; }
-  const double dynamic_power() const { return dynamic_power_; }
+  /**
+   * @brief Loads the design and the library from `snapshot` if it was built
+   * from the same source files (by content hash), snapshot version and
+   * simulation_patterns().
+   * Otherwise parses both, finds primitives and rewrites the snapshot.
+   * Call Initialize() afterwards as usual.
+   *
+   * @param design .aig file
+   * @param library .json file
+   * @param snapshot cache file, created if missing or stale
+   */
+  void LoadCached(const std::filesystem::path &design,
+                  const std::filesystem::path &library,
+                  const std::filesystem::path &snapshot);
+
+  /**
+   * @brief Writes the preprocessed design (graph, names, library and
+   * candidates) to `file`. Must be called after FindPrimitives.
+   *
+   * @param file destination path
+   * @param source_hash hash of the source files, checked on load
+   * @return true if successful
+   */
+  bool SaveSnapshot(const std::filesystem::path &file,
+                    uint64_t source_hash) const;
+
+  /**
+   * @brief Reads a snapshot written by SaveSnapshot.
+   *
+   * @param file
+   * @param source_hash expected hash of the source files
+   * @return false if the file is missing, stale or malformed
+   */
+  bool LoadSnapshot(const std::filesystem::path &file, uint64_t source_hash);
+
+  /// bump whenever the layout of anything in the snapshot changes
+  static constexpr uint32_t kSnapshotVersion = 2;
+
+  /**
+   * @brief Writes the mapping state, i.e. everything Initialize() and the
+   * update queries change, and rng(), for checkpoints. Timing is saved as
+   * on or off and recomputed on load. Not inside a transaction.
+   */
+  void SaveState(BinaryWriter &ar) const;
+
+  /**
+   * @brief Restores a state written by SaveState() of a mapper with the same
+   * design and library. Call after Initialize().
+   *
+   * @return false if it doesn't fit this design or is malformed (e.g. gate
+   * ids or literals out of range), leaving the current state as it was
+   */
+  bool LoadState(BinaryReader &ar);
+
+  /**
+   * @brief Writes the committed mapping compactly, for sending it to another
+   * process with the same design and library or restoring it later: the cell
+   * id of every AIG literal and the candidate index and cell id of every
+   * active gate. While a transaction is open, that is the mapping at Begin(),
+   * as in CaptureMapping().
+   */
+  void EncodeMapping(BinaryWriter &ar);
+
+  /**
+   * @brief Replaces the mapping with one written by EncodeMapping(). Call
+   * after Initialize(). Leaves rng() alone.
+   *
+   * @return false if it doesn't fit this design or is malformed, the mapping
+   * needs Initialize() again then
+   */
+  bool DecodeMapping(BinaryReader &ar);
+
+  // these include the pending proposal, if any
+  const double area() const { return area_ + pending_.delta.area; }
+  const double power() const { return power_ + pending_.delta.power; }
+  const double dynamic_power() const {
+    return dynamic_power_ + pending_.delta.dynamic_power;
+  }
 
   /**
    * @brief Setup the mapper. This assigns random gates, and then sets up AIG
    */
   void Initialize();
 
+  /**
+   * @brief Turns on static timing. Computes arrival and required times of
+   * every net of the mapping from scratch, after that each update query
+   * repropagates only the cones it touched. Call after Initialize().
+   * Proposals are applied eagerly (inside their transaction) while timing is
+   * on, since the delta walk does not cover timing.
+   */
+  void EnableTiming();
+
+  bool timing_enabled() const { return timing_enabled_; }
+
+  /**
+   * @brief Clock period used as the required time of the output ports.
+   * Decoded from the top module name on Initialize(), 0 if it has none.
+   */
+  double clock_period() const { return clock_period_; }
+  void set_clock_period(double clock_period);
+
+  /**
+   * @brief Worst negative slack over the output ports (0 if none is late).
+   */
+  double wns() const { return wns_; }
+
+  /**
+   * @brief Total negative slack over the output ports.
+   */
+  double tns() const { return tns_; }
+
+  /**
+   * @brief Arrival time of net `literal`. Gate delay is the cell's attr_b,
+   * input ports arrive at 0. Only meaningful for nets in the mapping.
+   */
+  double arrival(int literal) const { return arrival_[literal]; }
+
+  /**
+   * @brief Required time of net `literal`, infinity if nothing reads it.
+   */
+  double required(int literal) const { return required_[literal]; }
+
   /**
    * @brief Writes the mapping (in the weird verilog output form) to a file.
    * Note: In weird verilog, the output port is the last parameter instead of
@@ -48,6 +180,29 @@ class IterativeTechnologyMapper : public AIG {
    */
   void WriteMapping(const std::filesystem::path &file) const;
 
+  /**
+   * @brief Compact copy of a mapping: just the cells and gates, names and
+   * structure stay with the mapper.
+   */
+  struct MappingSnapshot {
+    std::vector<Cell::Id> cells;  // cell of each AIG literal, kNoId if unused
+    std::vector<Gate> gates;      // active gates, in gate id order
+  };
+
+  /**
+   * @brief Copies the committed mapping into `snapshot`, i.e. the mapping at
+   * Begin() while a transaction is open. Reuses its buffers.
+   */
+  void CaptureMapping(MappingSnapshot &snapshot);
+
+  /**
+   * @brief Writes a mapping captured from this mapper (or a copy of it), as
+   * WriteMapping does. Only reads the names and structure, which don't
+   * change while annealing, so it may run on another thread.
+   */
+  void WriteMapping(const std::filesystem::path &file,
+                    const MappingSnapshot &snapshot) const;
+
   /**
    * @brief Writes the mapping in verilog for ABC to read -- gate names omitted.
    *
@@ -65,6 +220,52 @@ class IterativeTechnologyMapper : public AIG {
    */
   void UndoGateAdd();
 
+  /**
+   * @brief Opens a transaction. Until Commit() or Rollback(), every field the
+   * update queries write is journaled along with the stats at this point.
+   * Transactions do not nest.
+   */
+  void Begin();
+
+  /**
+   * @brief Keeps the changes since Begin() and drops the journal.
+   */
+  void Commit();
+
+  /**
+   * @brief Reverts every change since Begin() by replaying the journal
+   * backwards, without re-running the cover/dependency cascade.
+   */
+  void Rollback();
+
+  bool in_transaction() const { return in_transaction_; }
+
+  /**
+   * @brief What-if queries. Walk the same cascade as the update queries
+   * without modifying the mapper and return the change in stats the update
+   * would cause. Not thread safe: they share scratch space in the mapper.
+   *
+   * @param cell cell to use for the added gate
+   */
+  Stats DeltaAddBinaryGate(const GateMapping *mapping, Cell::Id cell) const;
+  Stats DeltaRemoveBinaryGate(int gate_id) const;
+  Stats DeltaChangeAIGNodeGate(int aig_variable, Cell::Id new_cell) const;
+
+  /**
+   * @brief Proposals. Inside a transaction, records one update and its delta
+   * without applying it. The stat accessors include the delta right away;
+   * Commit() applies the update for real and Rollback() just drops it.
+   * At most one proposal per transaction.
+   */
+  void ProposeAddBinaryGate(const GateMapping *mapping, Cell::Id cell);
+  void ProposeRemoveBinaryGate(int gate_id);
+  void ProposeChangeAIGNodeGate(int aig_variable, Cell::Id new_cell);
+
+  /**
+   * @brief Same choice as AddRandomGate(), as a proposal.
+   */
+  void ProposeAddRandomGate();
+
   /**
    * @brief Updates an AIG node's gate. If it is already active, stats will
    * update as if removing then adding in a new gate.
@@ -72,7 +273,7 @@ class IterativeTechnologyMapper : public AIG {
    * @param aig_variable
    * @param new_cell
    */
-  void ChangeAIGNodeGate(int aig_variable, const Cell *new_cell);
+  void ChangeAIGNodeGate(int aig_variable, Cell::Id new_cell);
 
   /**
    * @brief Add the associated gate mapping. You can access it via
@@ -80,9 +281,11 @@ class IterativeTechnologyMapper : public AIG {
    * statistics (power, area, etc.).
    *
    * @param mapping
+   * @param cell cell to use, a random one of the mapping's type if kNoId
    * @return int gate_id of the newly added gate, -1 if failed to add
    */
-  int AddBinaryGate(const GateMapping *mapping);
+  int AddBinaryGate(const GateMapping *mapping,
+                    Cell::Id cell = Cell::kNoId);
 
   /**
    * @brief Query to remove the binary gate at gates_[gate_id] from cost.
@@ -91,15 +294,50 @@ class IterativeTechnologyMapper : public AIG {
    */
   void RemoveBinaryGate(int gate_id);
 
+  /**
+   * @brief Number of gates added on top of the AIG (active entries of gates_).
+   */
+  int num_active_gates() const { return num_active_gates_; }
+
+  /**
+   * @brief The `k`-th active gate id, for 0 <= k < num_active_gates().
+   * The order changes as gates are added and removed.
+   */
+  int active_gate(int k) const { return active_gates_[k]; }
+
+  /**
+   * @brief Uniformly random active gate id in O(1).
+   *
+   * @return gate_id, or -1 if no gates are active
+   */
+  int RandomActiveGate() {
+    if (num_active_gates_ == 0) return -1;
+    return active_gates_[rng_.Uniform(num_active_gates_)];
+  }
+
+  /**
+   * @brief The mapper's own random number generator, used for every random
+   * choice it makes. Not shared, so each mapper (thread, replica) draws from
+   * its own stream.
+   */
+  Random &rng() { return rng_; }
+
+  /**
+   * @brief Reseeds (or replaces, e.g. with a Random::Stream) rng(). Call
+   * before Initialize() to reproduce a run.
+   */
+  void set_seed(uint64_t seed) { rng_.Seed(seed); }
+  void set_rng(const Random &rng) { rng_ = rng; }
+
   const auto &aig_nodes() const { return aig_nodes_; }  // see aig_nodes_
   const auto &aig_gates() const { return aig_gates_; }  // see aig_gates_
   const auto &library() const { return library_; }
 
  private:
-  struct AIGAuxiliary {          // holds extra info about AIG nodes
-    const Cell *cell = nullptr;  // default cell -- nullptr for input nodes
-    bool active = false;         // whether its currently summed into cost
-    int covered_by = -1;         // index of the Gate this AIGNode is covered by
+  struct AIGAuxiliary {            // holds extra info about AIG nodes
+    Cell::Id cell = Cell::kNoId;  // default cell -- kNoId for input nodes
+    bool active = false;          // whether its currently summed into cost
+    int covered_by = -1;  // index of the Gate this AIGNode is covered by
     int deps = 0;  // how many nodes depend on this (outdegree) after mapping
   };
 
@@ -108,27 +346,56 @@ class IterativeTechnologyMapper : public AIG {
   };
 
   /**
-   * @brief Analyzes the AIG for primitive gate locations.
+   * @brief Analyzes the AIG for primitive gate locations. Enumerates the
+   * 4-feasible cuts of every AND gate and matches the 2-leaf cuts against the
+   * functions of the 2-input cell types in the library, filling candidates_.
    */
   void FindPrimitives();
 
+  /**
+   * @brief Starts over from the bare AIG with `cells` (one per literal) as
+   * the default cells, as in Initialize().
+   */
+  void ResetMapping(const std::vector<Cell::Id> &cells);
+
   int AddUnaryGate(const GateMapping &mapping);
 
   void RemoveUnaryGate(int gate_id);
 
+  /**
+   * The update cascade. `State` is where node, gate and stat writes go:
+   * DirectState writes into the mapper (journaled), OverlayState into
+   * scratch space for the delta queries. See the public wrappers.
+   */
+  struct DirectState;
+  struct OverlayState;
+
+  template <class State>
+  int AddBinaryGate(State &s, const GateMapping *mapping,
+                    Cell::Id cell) const;
+
+  template <class State>
+  void RemoveBinaryGate(State &s, int gate_id) const;
+
+  template <class State>
+  void ChangeAIGNodeGate(State &s, int aig_variable,
+                         Cell::Id new_cell) const;
+
   /**
    * @brief Query to remove the base gate of the AIG node from the cost.
    *
    * @param variable
    */
-  void CoverAIG(int variable);
+  template <class State>
+  void CoverAIG(State &s, int variable) const;
 
   /**
    * @brief Query to add the base gate of the AIG node to the cost.
    *
    * @param variable which AIG node to uncover
    */
-  void UncoverAIG(int variable);
+  template <class State>
+  void UncoverAIG(State &s, int variable) const;
 
   /**
    * Removes outdegree from the AIG node.
@@ -139,24 +406,158 @@ class IterativeTechnologyMapper : public AIG {
    * may still be read by other nets, so decrement the input net by one. When
    * the outdegree reaches zero, then the node can be pruned.
    */
-  void RemoveDependency(int variable);
+  template <class State>
+  void RemoveDependency(State &s, int variable) const;
 
   /**
    * @brief Add outdegree to AIG node. Something new now depends on `variable`.
    *
    * @param variable
    */
-  void AddDependency(int variable);
+  template <class State>
+  void AddDependency(State &s, int variable) const;
+
+  /**
+   * @brief Queues net `literal` for arrival time repropagation.
+   */
+  void MarkArrival(int literal) {
+    if (arrival_queued_[literal]) return;
+    arrival_queued_[literal] = true;
+    arrival_queue_.push_back(literal);
+    std::push_heap(arrival_queue_.begin(), arrival_queue_.end(),
+                   std::greater<int>());
+  }
+
+  /**
+   * @brief Queues net `literal` for required time repropagation.
+   */
+  void MarkRequired(int literal) {
+    if (required_queued_[literal]) return;
+    required_queued_[literal] = true;
+    required_queue_.push_back(literal);
+    std::push_heap(required_queue_.begin(), required_queue_.end());
+  }
+
+  /**
+   * @brief Queues the nets read by the current driver of `literal`.
+   */
+  void MarkDriverInputsRequired(int literal);
+
+  /**
+   * @brief Arrival time of `literal` from its driver's inputs.
+   */
+  double ComputeArrival(int literal) const;
+
+  /**
+   * @brief Required time of `literal` from its active readers.
+   */
+  double ComputeRequired(int literal) const;
+
+  /**
+   * @brief Drains both queues: arrival times in increasing literal order
+   * (topological), required times in decreasing order, stopping wherever a
+   * value does not change. Then updates wns_ and tns_.
+   */
+  void UpdateTiming();
+
+  /**
+   * @brief Writes `value` into `field` of the mapper state, journaling the
+   * old value while a transaction is open. Fields must not move (no vector
+   * reallocation) between Begin() and Rollback().
+   */
+  template <class T>
+  void Set(T &field, T value) {
+    static_assert(std::is_trivially_copyable_v<T> &&
+                  sizeof(T) <= sizeof(uint64_t));
+    if (in_transaction_) {
+      JournalEntry entry{&field, 0, sizeof(T)};
+      std::memcpy(&entry.old_value, &field, sizeof(T));
+      journal_.push_back(entry);
+    }
+    field = value;
+  }
+
+  /**
+   * @brief Copies the current mapping, including uncommitted writes.
+   */
+  void GatherMapping(MappingSnapshot &snapshot) const;
+
+  /**
+   * @brief Undoes the writes of the open transaction in place, keeping the
+   * written values in `redo` for RedoJournal(). Nothing to undo outside a
+   * transaction.
+   */
+  void UndoJournal(std::vector<uint64_t> &redo);
+  void RedoJournal(const std::vector<uint64_t> &redo);
+
+  struct JournalEntry {  // one field write inside a transaction
+    void *field;         // address of the field
+    uint64_t old_value;  // bytes of the value before the write
+    uint8_t size;        // sizeof the field
+  };
+
+  struct Proposal {  // an update recorded but not applied yet
+    enum Kind { kNone, kAddBinaryGate, kRemoveBinaryGate, kChangeAIGNodeGate };
+    Kind kind = kNone;
+    const GateMapping *mapping = nullptr;
+    Cell::Id cell = Cell::kNoId;
+    int target = -1;  // gate id or AIG variable
+    Stats delta;
+  };
+
+  bool primitives_found_ = false;  // whether candidates_ is filled
+
+  Random rng_;  // not journaled: rolled back moves still consume draws
 
   double area_ = 0;           // area of the current mapping
   double power_ = 0;          // power of current mapping
   double dynamic_power_ = 0;  // dynamic power of current mapping
   Library library_;
 
+  bool in_transaction_ = false;
+  std::vector<JournalEntry> journal_;  // writes since Begin(), in order
+  Stats begin_stats_;                  // stats at Begin()
+  size_t begin_added_gates_ = 0;       // added_gates_.size() at Begin()
+  Proposal pending_;                   // applied on Commit()
+
+  // scratch space of OverlayState, entries are valid when stamped with the
+  // current epoch so nothing needs clearing between queries
+  mutable std::vector<AIGAuxiliary> shadow_nodes_;
+  mutable std::vector<uint32_t> shadow_stamp_;  // per literal
+  mutable std::vector<uint32_t> freed_stamp_;   // per gate id
+  mutable uint32_t shadow_epoch_ = 0;
+
+  // gate slot allocation, all fixed size (one slot per literal) and written
+  // through Set() so transactions cover them
+  std::vector<int> free_slots_;       // stack of unused gate ids
+  int num_free_slots_ = 0;            // size of the free_slots_ stack
+  std::vector<int> active_gates_;     // dense list of active gate ids
+  std::vector<int> active_position_;  // index of a gate id in active_gates_
+  int num_active_gates_ = 0;          // size of the active_gates_ list
+
+  // static timing, arrival_/required_ per literal, all written through Set()
+  bool timing_enabled_ = false;
+  double clock_period_ = 0;
+  double wns_ = 0;
+  double tns_ = 0;
+  std::vector<double> arrival_;
+  std::vector<double> required_;
+  std::vector<int> output_ports_;  // how many output ports a literal drives
+  std::vector<uint32_t> reader_offsets_;  // candidates reading literal i
+  std::vector<uint32_t> readers_;         // start here, indices in candidates_
+  std::vector<int> arrival_queue_;        // min-heap of literals
+  std::vector<int> required_queue_;       // max-heap of literals
+  std::vector<uint8_t> arrival_queued_;
+  std::vector<uint8_t> required_queued_;
+
   std::vector<int> added_gates_;          // history of added gates (stack)
-  std::vector<GateMapping> candidates_;   // candidate gates for tech map
   std::vector<AIGAuxiliary> aig_nodes_;   // extra data for AIG nodes
   std::vector<GateAuxiliary> aig_gates_;  // extra data for AIG gates
+
+  // candidate gates for tech map, immutable once found and shared between
+  // copies of the mapper so that GateMapping pointers stay valid in copies
+  std::shared_ptr<const std::vector<GateMapping>> candidates_ =
+      std::make_shared<const std::vector<GateMapping>>();
 };
 
 #endif  // SRC_ITERATIVE_TECHNOLOGY_MAPPER_
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "library.hh"
 
+#include <cassert>
 #include <fstream>
 #include <iostream>
 
@@ -18,15 +19,36 @@ void Library::Load(const std::filesystem::path &file) {
     }
     cells_[c.name()] = c;
   }
+  Compile();
   std::cout << "[load] lib n=" << n_ << " m=" << m_ << std::endl;
 }
 
-const std::vector<const Cell*> Library::GetCellsByType(Cell::Type type) const {
-  std::vector<const Cell*> out;
+void Library::Compile() {
+  assert(cells_.size() < Cell::kNoId && "Too many cells for 16-bit ids.");
+  table_.clear();
+  area_.clear();
+  leakage_power_.clear();
+  delay_.clear();
+  capacitance_.clear();
+  power_domain_.clear();
   for (const auto &[cell_name, cell] : cells_) {
-    if (cell.type() == type) {
-      out.push_back(&cell);
-    }
+    table_.push_back(cell);
+    area_.push_back(cell.area());
+    leakage_power_.push_back(cell.leakage_power());
+    delay_.push_back(cell.b());
+    capacitance_.push_back(cell.capacitance());
+    power_domain_.push_back(cell.power_domain());
+  }
+
+  // counting sort of the ids by type, stable so each type stays name ordered
+  type_offsets_.assign(Cell::Type::kNumTypes + 1, 0);
+  for (const auto &cell : table_) ++type_offsets_[cell.type() + 1];
+  for (int t = 0; t < Cell::Type::kNumTypes; ++t) {
+    type_offsets_[t + 1] += type_offsets_[t];
+  }
+  ids_by_type_.resize(table_.size());
+  std::vector<uint32_t> fill(type_offsets_.begin(), type_offsets_.end() - 1);
+  for (size_t id = 0; id < table_.size(); ++id) {
+    ids_by_type_[fill[table_[id].type()]++] = id;
   }
-  return std::move(out);
 }
@@ -7,13 +7,14 @@
 #include <vector>
 
 #include "cell.hh"
+#include "utils.hh"
 
 /**
  * @brief Represents a cell library. Supports load and lookup.
  */
 class Library {
  public:
-  Library() {}
+  Library() : type_offsets_(Cell::Type::kNumTypes + 1, 0) {}
 
   /**
    * @brief Loads the file into the library. This handles parsing.
@@ -33,16 +34,46 @@ class Library {
   }
 
   /**
-   * @brief get a list of cells by type
+   * @brief get the cells of a type, no allocation
    *
    * @param type
-   * @return const std::vector<const Cell*> cells in library that match the type
+   * @return Span<const Cell::Id> ids of the cells in library that match the
+   * type, by name
    */
-  const std::vector<const Cell*> GetCellsByType(Cell::Type type) const;
+  Span<const Cell::Id> GetCellsByType(Cell::Type type) const {
+    const Cell::Id* ids = ids_by_type_.data();
+    return {ids + type_offsets_[type], ids + type_offsets_[type + 1]};
+  }
 
   auto& cells() { return cells_; }
   const auto& cells() const { return cells_; }
 
+  /**
+   * @brief Builds the dense cell table from `cells_`: ids in name order, one
+   * array per attribute used in the hot paths and the ids grouped by type.
+   * Load() invokes this; call it again after editing `cells()`.
+   */
+  void Compile();
+
+  // compiled cell table, indexed by Cell::Id
+  size_t size() const { return table_.size(); }
+  const Cell& cell(Cell::Id id) const { return table_[id]; }
+  double area(Cell::Id id) const { return area_[id]; }
+  double leakage_power(Cell::Id id) const { return leakage_power_[id]; }
+  double delay(Cell::Id id) const { return delay_[id]; }
+  double capacitance(Cell::Id id) const { return capacitance_[id]; }
+  int power_domain(Cell::Id id) const { return power_domain_[id]; }
+
+  /**
+   * @brief Passes every field to `ar`, see serialization.hh.
+   */
+  template <class Archive>
+  void Serialize(Archive& ar) {
+    ar(n_, m_, attributes_, cells_);
+    ar(table_, area_, leakage_power_, delay_, capacitance_, power_domain_,
+       ids_by_type_, type_offsets_);
+  }
+
  private:
   /// @brief how many cells there are
   int n_;
@@ -54,6 +85,16 @@ class Library {
   std::vector<std::string> attributes_;
 
   std::map<std::string, Cell> cells_;
+
+  // compiled cell table, see Compile()
+  std::vector<Cell> table_;
+  std::vector<double> area_;
+  std::vector<double> leakage_power_;
+  std::vector<double> delay_;  // attr_b
+  std::vector<double> capacitance_;
+  std::vector<int> power_domain_;
+  std::vector<Cell::Id> ids_by_type_;     // ids sorted by type
+  std::vector<uint32_t> type_offsets_;  // type t starts at type_offsets_[t]
 };
 
 #endif  // ICCAD_SRC_LIBRARY_H_
\ No newline at end of file
@@ -8,29 +8,24 @@
 
 #include <bits/stdc++.h>
 
-std::vector<std::chrono::_V2::system_clock::time_point> times;
-void StartClock() {
-  times.push_back(std::chrono::high_resolution_clock::now());
-}
-int EndClock() {
-  auto t0_ = times.back();
-  times.pop_back();
-  using std::chrono::high_resolution_clock;
-  using std::chrono::duration_cast;
-  using std::chrono::duration;
-  using std::chrono::milliseconds;
-  auto t1 = std::chrono::high_resolution_clock::now();
-  auto ms_int = duration_cast<milliseconds>(t1 - t0_);
-  return ms_int.count();
-}
-std::map<std::string, int> kTiming;
+#include "cost_estimator.hh"
+#include "cost_server.hh"
+#include "random.hh"
+#include "temperature_schedule.hh"
+#include "timing.hh"
+
+std::map<std::string, double> kTiming;  // ms
 std::map<std::string, int> kInvocation;
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <fstream>
 std::string cost_function_path, library_path, input_netlist_path, output_path;
-double Evaluate() {
+
+/**
+ * @brief Runs the external cost function on the netlist at `output_path`.
+ */
+double EvaluateExternal() {
   const std::string cost_output_path = "cost_eval.txt";
   std::string cmd = cost_function_path
     + " -library " + library_path
@@ -62,7 +57,8 @@ double AcceptProbability(double E, double Ep, double T) {
   else return std::exp(-(Ep - E) / T);
 }
 
-void Write(std::vector<std::string> header, std::vector<std::string> body) {
+void Write(const std::vector<std::string>& header,
+           const std::vector<std::string>& body) {
   StartClock();
   
   std::ofstream fout(output_path);
@@ -75,8 +71,85 @@ void Write(std::vector<std::string> header, std::vector<std::string> body) {
   ++kInvocation["write"];
 }
 
+// in-process (-eval internal) or cost server (-eval server) evaluation: the
+// netlist written to `output_path` once, then kept in sync with the body by
+// gate variant
+enum class EvalMode { kExternal, kInternal, kServer };
+EvalMode eval_mode = EvalMode::kExternal;
+CostFunction cost_function;
+std::unique_ptr<CostClient> cost_client;
+std::string pending_cells;  // "GATE CELL" pairs not sent to the server yet
+
+/**
+ * @brief Cell name of a body line, e.g. "nand_3".
+ */
+std::string CellName(const std::string& line, int variant_idx) {
+  return line.substr(1, variant_idx);
+}
+
+/**
+ * @brief Updates the in-process netlist to the variants of the gates
+ * `changed` in the body. The server's copy is updated with the next
+ * evaluation. No-op for external evaluation.
+ */
+void SyncCells(const std::vector<std::string>& body,
+               const std::vector<int>& body_idx,
+               const std::vector<int>& changed) {
+  for (int idx : changed) {
+    if (eval_mode == EvalMode::kInternal) {
+      cost_function.SetGateCell(idx, CellName(body[idx], body_idx[idx]));
+    } else if (eval_mode == EvalMode::kServer) {
+      pending_cells += " " + std::to_string(idx) + " " +
+                       CellName(body[idx], body_idx[idx]);
+    }
+  }
+}
+
+/**
+ * @brief Cost of the netlist after changing the gates `changed` of the
+ * body. In-process or on the cost server, only those gates are updated,
+ * otherwise the whole netlist is written and evaluated by the external cost
+ * function.
+ */
+double Evaluate(const std::vector<std::string>& header,
+                const std::vector<std::string>& body,
+                const std::vector<int>& body_idx,
+                const std::vector<int>& changed) {
+  if (eval_mode == EvalMode::kExternal) {
+    Write(header, body);
+    return EvaluateExternal();
+  }
+  StartClock();
+  SyncCells(body, body_idx, changed);
+  double cost;
+  if (eval_mode == EvalMode::kInternal) {
+    cost = cost_function.Compute().cost;
+    kTiming["cost_eval_internal"] += EndClock();
+    ++kInvocation["cost_eval_internal"];
+  } else {
+    CostFunction::Result result;
+    if (!cost_client->Evaluate("set" + pending_cells, result)) {
+      std::cout << "Cost server failed.\n";
+      exit(1);
+    }
+    pending_cells.clear();
+    cost = result.cost;
+    kTiming["cost_eval_server"] += EndClock();
+    ++kInvocation["cost_eval_server"];
+  }
+  return cost;
+}
+
 int32_t main(int argc, char** argv) {
-  std::srand(1);
+  std::string seed = "1";
+  // or internal: CostFunction in-process, or server: a cost_estimator
+  // -server listening on -cost_server
+  std::string eval = "external";
+  std::string cost_server;  // e.g. unix:/tmp/cost.sock
+  std::string cross_check = "100";  // accepted moves between external checks
+  // > 0 estimates the dynamic power internally from that many simulated
+  // patterns instead of analytically like the reference cost function
+  std::string sim_patterns = "0";
   std::string* write_to = nullptr;
   for (int i = 1; i < argc; ++i) {
     std::string arg = argv[i];
@@ -84,6 +157,11 @@ int32_t main(int argc, char** argv) {
     else if (arg == "-cost_function") write_to = &cost_function_path;
     else if (arg == "-netlist") write_to = &input_netlist_path;
     else if (arg == "-output") write_to = &output_path;
+    else if (arg == "-seed") write_to = &seed;
+    else if (arg == "-eval") write_to = &eval;
+    else if (arg == "-cross_check") write_to = &cross_check;
+    else if (arg == "-cost_server") write_to = &cost_server;
+    else if (arg == "-sim_patterns") write_to = &sim_patterns;
     else {
       if (write_to) *write_to = arg;
       write_to = nullptr;
@@ -94,10 +172,34 @@ int32_t main(int argc, char** argv) {
     std::cout << err << "\n"; \
     return 1; \
   }
-  THROW_IF_EMPTY(cost_function_path, "Missing cost function.")
+  if (eval == "internal") eval_mode = EvalMode::kInternal;
+  else if (eval == "server") eval_mode = EvalMode::kServer;
+  else if (eval != "external") {
+    std::cout << "Unknown -eval " << eval
+              << ", expected external, internal or server.\n";
+    return 1;
+  }
+  const long long simulation_patterns = std::stoll(sim_patterns);
+  if (simulation_patterns > 0 && eval_mode != EvalMode::kInternal) {
+    std::cout << "-sim_patterns needs -eval internal.\n";
+    return 1;
+  }
+  // simulated costs differ from the reference by design, nothing to check
+  const int cross_check_interval =
+      eval_mode != EvalMode::kExternal && simulation_patterns == 0
+          ? std::stoi(cross_check)
+          : 0;
+  if (eval_mode == EvalMode::kExternal || cross_check_interval > 0) {
+    THROW_IF_EMPTY(cost_function_path, "Missing cost function.")
+  }
+  if (eval_mode == EvalMode::kServer) {
+    THROW_IF_EMPTY(cost_server, "Missing cost server.")
+  }
   THROW_IF_EMPTY(library_path, "Missing library.")
   THROW_IF_EMPTY(input_netlist_path, "Missing netlist.")
   THROW_IF_EMPTY(output_path, "Missing output.")
+  Random rng(std::stoull(seed));
+  std::cout << "seed=" << seed << "\n";
 
   std::vector<std::string> header, body, best_body;
   std::vector<int> body_idx;
@@ -144,29 +246,70 @@ int32_t main(int argc, char** argv) {
   header.pop_back(); // endmodule
 
   const std::vector<std::string> original_body = body;
+  std::vector<int> all_gates(body.size());
+  std::iota(all_gates.begin(), all_gates.end(), 0);
+
+  if (eval_mode == EvalMode::kInternal) {
+    Write(header, body);
+    cost_function.set_simulation_patterns(simulation_patterns);
+    cost_function.LoadNetlist(output_path);
+    cost_function.LoadLibrary(library_path);
+    if (cost_function.netlist().num_gates() != (int)body.size()) {
+      std::cout << "Netlist has " << cost_function.netlist().num_gates()
+                << " gates, expected " << body.size() << ".\n";
+      return 1;
+    }
+  }
+  if (eval_mode == EvalMode::kServer) {
+    // the server evaluates with its own library
+    Write(header, body);
+    cost_client = std::make_unique<CostClient>(cost_server);
+    std::string reply;
+    const std::string netlist = std::filesystem::absolute(output_path);
+    if (!cost_client->Request("netlist " + netlist, reply) ||
+        reply.rfind("error", 0) == 0 || !cost_client->Request("gates", reply)) {
+      std::cout << "Cost server failed: " << reply << "\n";
+      return 1;
+    }
+    if (reply != std::to_string(body.size())) {
+      std::cout << "Netlist has " << reply << " gates, expected "
+                << body.size() << ".\n";
+      return 1;
+    }
+  }
+  int accepted = 0;
   double E_low = 1e300;
 
   std::vector<double> uphill_deltas;
   std::map<double, std::vector<double>> cost_deltas;
 
+  // warm-up: sample single gate changes to calibrate the initial temperature
+  {
+    const double E = Evaluate(header, body, body_idx, all_gates);
+    for (int i = 0; i < 30; ++i) {
+      int idx = rng.Uniform(body.size());
+      char old_variant = body[idx][body_idx[idx]];
+      body[idx][body_idx[idx]] = rng.Uniform(body_variants[idx]) + '1';
+      double Ep = Evaluate(header, body, body_idx, {idx});
+      if (Ep > E) uphill_deltas.push_back(Ep - E);
+      body[idx][body_idx[idx]] = old_variant;
+      SyncCells(body, body_idx, {idx});
+    }
+  }
+
   for (int tn = 0; tn < 3; ++tn) {
     body = original_body;
-    Write(header, body);
-    double E = Evaluate();
+    double E = Evaluate(header, body, body_idx, all_gates);
 
     const int kMaxIter = 3000;
-    const double kMaxTemp = 1e-2;
-    const double kMinTemp = 1e-6;
-    double T;
-    double T1 = std::abs(6.1445297e-1 / std::log(0.8));
+    const double kMinTemp = 1e-6;  // if the warm-up saw no uphill move
+    AdaptiveSchedule schedule(kMaxIter);
+    schedule.Calibrate(uphill_deltas);
 
     for (int i = 0; i < kMaxIter; ++i) {
       StartClock();
 
-      // T = (std::exp(1 - i / (double)kMaxIter) - 1) / (std::exp(1.0) - 1) * (kMaxTemp - kMinTemp) + kMinTemp;
-      T = T1 * 0.2 / i;
-      if (i == 0) T = T1;
-      else if (i < 500) T /= 100;
+      const double T = schedule(kMinTemp, i);
 
       if (i % 10 == 0) {
         std::cout << std::fixed
@@ -183,36 +326,53 @@ int32_t main(int argc, char** argv) {
       if (i < 10) {
         for (int idx = 0; idx < body.size(); ++idx) {
           char old_variant = body[idx][body_idx[idx]];
-          char new_variant = (std::rand() % body_variants[idx]) + '1';
+          char new_variant = rng.Uniform(body_variants[idx]) + '1';
           changes.push_back({idx, old_variant, new_variant});
         }
       }
       for (int j = 0; j < 1; ++j) {
-        int idx = std::rand() % body.size();
+        int idx = rng.Uniform(body.size());
         char old_variant = body[idx][body_idx[idx]];
-        char new_variant = (std::rand() % body_variants[idx]) + '1';
+        char new_variant = rng.Uniform(body_variants[idx]) + '1';
         changes.push_back({idx, old_variant, new_variant});
       }
       // apply update
-      for (auto [idx, _, v] : changes) body[idx][body_idx[idx]] = v;
-      Write(header, body);
-      double Ep = Evaluate();
+      std::vector<int> changed;
+      for (auto [idx, _, v] : changes) {
+        body[idx][body_idx[idx]] = v;
+        changed.push_back(idx);
+      }
+      double Ep = Evaluate(header, body, body_idx, changed);
 
-      // average uphill cost
-      // if (Ep > E) uphill_deltas.push_back(Ep - E);
       // cost delta
       // cost_deltas[std::round(std::log2(T))].push_back(Ep - E);
 
-      if (AcceptProbability(E, Ep, T) * RAND_MAX >= std::rand()) {
+      const bool accept = rng.UniformReal() < AcceptProbability(E, Ep, T);
+      if (Ep > E) schedule.Observe(accept);
+      if (accept) {
         // keep it
         E = Ep;
         if (E < E_low) {
           E_low = E;
           best_body = body;
         }
+        // the external cost function stays the reference
+        if (cross_check_interval > 0 &&
+            ++accepted % cross_check_interval == 0) {
+          Write(header, body);
+          StartClock();
+          const double reference = EvaluateExternal();
+          kTiming["cross_check"] += EndClock();
+          ++kInvocation["cross_check"];
+          if (std::abs(reference - E) > 1e-6 * std::abs(reference)) {
+            std::cerr << "cost mismatch: internal " << E << " external "
+                      << reference << std::endl;
+          }
+        }
       } else {
         // discard the change
         for (auto [idx, revert, _] : changes) body[idx][body_idx[idx]] = revert;
+        SyncCells(body, body_idx, changed);
       }
 
       kTiming["iter"] += EndClock();
@@ -225,16 +385,13 @@ int32_t main(int argc, char** argv) {
   std::cout << "best = " << E_low << std::endl;
 
   // double tot = 0;
-  // for (auto x : uphill_deltas) tot += x;
-  // std::cout << "avg uphill = " << (tot/uphill_deltas.size()) << "\n";
-
   // for (auto [k, a] : cost_deltas) {
   //   tot = 0;
   //   for (auto x : a) tot += x;
   //   std::cout << "bucket=" << k << " cost_avg= " << (tot/a.size()) << "\n";
   // }
 
-  std::cout << std::endl;
+  std::cout << std::endl << std::fixed << std::setprecision(3);
   for (auto [k, tot] : kTiming) {
     int n = kInvocation[k];
     std::cout << std::setw(20) << k 
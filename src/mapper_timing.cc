@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <limits>
+
+#include "iterative_technology_mapper.hh"
+
+namespace {
+
+constexpr double kInfinity = std::numeric_limits<double>::infinity();
+
+}  // namespace
+
+void IterativeTechnologyMapper::EnableTiming() {
+  const int num_literals = sz_v_ * 2;
+
+  output_ports_.assign(num_literals, 0);
+  for (int x : outputs_) ++output_ports_[x];
+
+  // candidate gates reading each literal, CSR like the AIG fanout index
+  reader_offsets_.assign(num_literals + 1, 0);
+  const auto& candidates = *candidates_;
+  for (const auto& c : candidates) {
+    ++reader_offsets_[c.a + 1];
+    if (c.b != c.a) ++reader_offsets_[c.b + 1];
+  }
+  for (int i = 0; i < num_literals; ++i) {
+    reader_offsets_[i + 1] += reader_offsets_[i];
+  }
+  readers_.resize(reader_offsets_[num_literals]);
+  std::vector<uint32_t> fill(reader_offsets_.begin(), reader_offsets_.end());
+  for (uint32_t k = 0; k < candidates.size(); ++k) {
+    const auto& c = candidates[k];
+    readers_[fill[c.a]++] = k;
+    if (c.b != c.a) readers_[fill[c.b]++] = k;
+  }
+
+  arrival_queue_.clear();
+  required_queue_.clear();
+  arrival_queued_.assign(num_literals, false);
+  required_queued_.assign(num_literals, false);
+
+  // literals are in topological order (fanins and cut leaves come first),
+  // so one sweep each way computes everything
+  arrival_.assign(num_literals, 0);
+  required_.assign(num_literals, kInfinity);
+  for (int i = 0; i < num_literals; ++i) arrival_[i] = ComputeArrival(i);
+  for (int i = num_literals - 1; i >= 0; --i) {
+    required_[i] = ComputeRequired(i);
+  }
+
+  wns_ = tns_ = 0;
+  for (int x : outputs_) {
+    const double slack = clock_period_ - arrival_[x];
+    wns_ = std::min(wns_, slack);
+    tns_ += std::min(0.0, slack);
+  }
+  timing_enabled_ = true;
+}
+
+void IterativeTechnologyMapper::set_clock_period(double clock_period) {
+  clock_period_ = clock_period;
+  if (timing_enabled_) EnableTiming();  // every required time moves
+}
+
+void IterativeTechnologyMapper::MarkDriverInputsRequired(int literal) {
+  const auto& aig_node = aig_nodes_[literal];
+  if (aig_node.covered_by != -1) {
+    const auto& gate = gates_[aig_node.covered_by];
+    MarkRequired(gate.a);
+    MarkRequired(gate.b);
+  } else if (aig_node.active) {
+    if (literal & 1) {
+      MarkRequired(literal ^ 1);
+    } else {
+      for (int x : nodes_.inputs[literal]) MarkRequired(x);
+    }
+  }
+}
+
+double IterativeTechnologyMapper::ComputeArrival(int literal) const {
+  if (!(literal & 1) && literal / 2 < sz_i_) return 0;  // input port
+  const auto& aig_node = aig_nodes_[literal];
+  if (aig_node.covered_by != -1) {
+    const auto& gate = gates_[aig_node.covered_by];
+    return std::max(arrival_[gate.a], arrival_[gate.b]) +
+           library_.delay(gate.cell);
+  }
+  if (!aig_node.active) return 0;  // not part of the mapping
+  const double delay = library_.delay(aig_node.cell);
+  if (literal & 1) return arrival_[literal ^ 1] + delay;
+  auto [x, y] = nodes_.inputs[literal];
+  return std::max(arrival_[x], arrival_[y]) + delay;
+}
+
+double IterativeTechnologyMapper::ComputeRequired(int literal) const {
+  double required = output_ports_[literal] ? clock_period_ : kInfinity;
+  for (uint32_t z : fanouts(literal)) {
+    const auto& reader = aig_nodes_[z];
+    if (reader.active) {
+      required =
+          std::min(required, required_[z] - library_.delay(reader.cell));
+    }
+  }
+  if (!(literal & 1)) {  // its inverter
+    const auto& reader = aig_nodes_[literal + 1];
+    if (reader.active) {
+      required = std::min(required,
+                          required_[literal + 1] - library_.delay(reader.cell));
+    }
+  }
+  for (uint32_t k = reader_offsets_[literal]; k < reader_offsets_[literal + 1];
+       ++k) {
+    const auto& c = (*candidates_)[readers_[k]];
+    const int gate_id = aig_nodes_[c.y].covered_by;
+    if (gate_id != -1 && aig_gates_[gate_id].mapping == &c) {
+      const double delay = library_.delay(gates_[gate_id].cell);
+      required = std::min(required, required_[c.y] - delay);
+    }
+  }
+  return required;
+}
+
+void IterativeTechnologyMapper::UpdateTiming() {
+  bool rescan_wns = false;
+
+  // forward: a net's arrival only depends on smaller literals
+  while (!arrival_queue_.empty()) {
+    std::pop_heap(arrival_queue_.begin(), arrival_queue_.end(),
+                  std::greater<int>());
+    const int n = arrival_queue_.back();
+    arrival_queue_.pop_back();
+    arrival_queued_[n] = false;
+
+    const double old_arrival = arrival_[n];
+    const double new_arrival = ComputeArrival(n);
+    if (new_arrival == old_arrival) continue;  // cut off
+    Set(arrival_[n], new_arrival);
+
+    if (output_ports_[n]) {
+      const double old_slack = clock_period_ - old_arrival;
+      const double new_slack = clock_period_ - new_arrival;
+      Set(tns_, tns_ + output_ports_[n] * (std::min(0.0, new_slack) -
+                                           std::min(0.0, old_slack)));
+      if (new_slack < wns_) {
+        Set(wns_, new_slack);
+      } else if (old_slack <= wns_ && new_slack > old_slack) {
+        rescan_wns = true;  // the worst output may have improved
+      }
+    }
+
+    for (uint32_t z : fanouts(n)) MarkArrival(z);
+    if (!(n & 1)) MarkArrival(n + 1);
+    for (uint32_t k = reader_offsets_[n]; k < reader_offsets_[n + 1]; ++k) {
+      MarkArrival((*candidates_)[readers_[k]].y);
+    }
+  }
+
+  // backward: a net's required time only depends on larger literals
+  while (!required_queue_.empty()) {
+    std::pop_heap(required_queue_.begin(), required_queue_.end());
+    const int n = required_queue_.back();
+    required_queue_.pop_back();
+    required_queued_[n] = false;
+
+    const double new_required = ComputeRequired(n);
+    if (new_required == required_[n]) continue;  // cut off
+    Set(required_[n], new_required);
+    MarkDriverInputsRequired(n);
+  }
+
+  if (rescan_wns) {
+    double wns = 0;
+    for (int x : outputs_) wns = std::min(wns, clock_period_ - arrival_[x]);
+    Set(wns_, wns);
+  }
+}
@@ -0,0 +1,84 @@
+#include "mapping_writer.hh"
+
+#include <iostream>
+#include <system_error>
+#include <utility>
+
+namespace {
+
+void OnTerminationSignal(int signal) {
+  termination_requested = 1;
+  std::signal(signal, SIG_DFL);  // the next one kills
+}
+
+}  // namespace
+
+void InstallTerminationHandler() {
+  std::signal(SIGTERM, OnTerminationSignal);
+  std::signal(SIGINT, OnTerminationSignal);
+}
+
+MappingWriter::MappingWriter(const IterativeTechnologyMapper& mapper,
+                             const std::filesystem::path& file,
+                             double min_interval)
+    : mapper_(mapper),
+      file_(file),
+      min_interval_(std::chrono::duration_cast<
+                    std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(min_interval))),
+      last_submit_(std::chrono::steady_clock::now() - min_interval_),
+      thread_(&MappingWriter::Loop, this) {}
+
+MappingWriter::~MappingWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+void MappingWriter::Submit(IterativeTechnologyMapper& mapper) {
+  mapper.CaptureMapping(spare_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::swap(spare_, queued_);
+    has_queued_ = true;
+  }
+  cv_.notify_one();
+  last_submit_ = std::chrono::steady_clock::now();
+}
+
+void MappingWriter::Loop() {
+  MappingSnapshot writing;
+  auto last_write = std::chrono::steady_clock::now() - min_interval_;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [&] { return has_queued_ || stop_; });
+    if (!has_queued_) break;  // stopping, everything is written
+    // coalesce: later submissions replace this one until the interval is up
+    cv_.wait_until(lock, last_write + min_interval_, [&] { return stop_; });
+    std::swap(writing, queued_);
+    has_queued_ = false;
+    lock.unlock();
+
+    const auto start = std::chrono::steady_clock::now();
+    std::filesystem::path tmp = file_;
+    tmp += ".tmp";
+    mapper_.WriteMapping(tmp, writing);
+    std::error_code error;
+    std::filesystem::rename(tmp, file_, error);
+    if (error) {
+      std::cerr << "[writer] failed to write " << file_ << ": "
+                << error.message() << std::endl;
+    }
+    last_write = std::chrono::steady_clock::now();
+    const double seconds =
+        std::chrono::duration<double>(last_write - start).count();
+    if (seconds > write_seconds()) {
+      write_seconds_.store(seconds, std::memory_order_relaxed);
+    }
+
+    lock.lock();
+  }
+}
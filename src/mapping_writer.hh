@@ -0,0 +1,105 @@
+/**
+ * @file mapping_writer.hh
+ * @brief Writes the best mapping found so far on a background thread, so that
+ * annealing never waits on disk I/O.
+ */
+
+#ifndef SRC_MAPPING_WRITER_HH_
+#define SRC_MAPPING_WRITER_HH_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+#include "iterative_technology_mapper.hh"
+
+/**
+ * @brief Background writer for mapping snapshots.
+ *
+ * Submit() captures the mapping (a compact copy of its cells and gates) and
+ * queues it, replacing any mapping still queued. The writer thread writes at
+ * most once per `min_interval`, so bursts of submissions are coalesced into
+ * the latest one. The last submitted mapping is always written before the
+ * destructor returns. Files are replaced atomically (temp file + rename).
+ *
+ * Usage example
+```cpp
+MappingWriter writer(mapper, "out.v", 1.0);
+...
+if (writer.due()) writer.Submit(mapper);  // cheap, no I/O
+```
+ */
+class MappingWriter {
+ public:
+  /**
+   * @param mapper provides the names and structure when writing, it must
+   * outlive the writer and not be reassigned meanwhile
+   * @param file destination path
+   * @param min_interval minimum seconds between two writes
+   */
+  MappingWriter(const IterativeTechnologyMapper& mapper,
+                const std::filesystem::path& file, double min_interval);
+  ~MappingWriter();
+  MappingWriter(const MappingWriter&) = delete;
+  MappingWriter& operator=(const MappingWriter&) = delete;
+
+  /**
+   * @brief Queues the committed mapping of `mapper` (this writer's mapper or
+   * a copy of it). Not thread-safe, submit from one thread at a time.
+   */
+  void Submit(IterativeTechnologyMapper& mapper);
+
+  /**
+   * @brief Whether `min_interval` has passed since the last Submit(), i.e.
+   * a submission now would not just be coalesced.
+   */
+  bool due() const {
+    return std::chrono::steady_clock::now() >= last_submit_ + min_interval_;
+  }
+
+  /**
+   * @brief Seconds taken by the slowest write so far, 0 before the first.
+   */
+  double write_seconds() const {
+    return write_seconds_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  typedef IterativeTechnologyMapper::MappingSnapshot MappingSnapshot;
+
+  void Loop();
+
+  const IterativeTechnologyMapper& mapper_;
+  const std::filesystem::path file_;
+  const std::chrono::steady_clock::duration min_interval_;
+  std::chrono::steady_clock::time_point last_submit_;
+
+  std::mutex mutex_;  // guards queued_, has_queued_ and stop_
+  std::condition_variable cv_;
+  MappingSnapshot spare_;   // captured into by Submit(), then swapped in
+  MappingSnapshot queued_;  // latest submission not written yet
+  bool has_queued_ = false;
+  bool stop_ = false;
+  std::atomic<double> write_seconds_{0};
+  std::thread thread_;
+};
+
+inline volatile std::sig_atomic_t termination_requested = 0;
+
+/**
+ * @brief Makes SIGTERM and SIGINT request a clean stop instead of killing the
+ * process, so that the best mapping is flushed. A second signal kills.
+ */
+void InstallTerminationHandler();
+
+/**
+ * @brief Whether a stop was requested by a signal, cheap enough to poll in
+ * the SA loop.
+ */
+inline bool TerminationRequested() { return termination_requested; }
+
+#endif  // SRC_MAPPING_WRITER_HH_
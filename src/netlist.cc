@@ -1,9 +1,13 @@
 #include "netlist.hh"
 
+#include <algorithm>
 #include <queue>
 #include <sstream>
 #include <unordered_map>
 
+#include "random.hh"
+#include "utils.hh"
+
 void Netlist::Load(const std::filesystem::__cxx11::path &file) { read(file); }
 
 void Netlist::LoadLibrary(Library &lib) {
@@ -20,6 +24,14 @@ void Netlist::LoadLibrary(Library &lib) {
 }
 
 double Netlist::ComputeDynamicPower(const Library &lib) const {
+  if (!switching_.empty()) {
+    double dynamic_power = 0.0;
+    for (size_t i = 0; i < gates_.size(); ++i) {
+      dynamic_power += switching_[i] * gates_[i].cell().leakage_power();
+    }
+    return dynamic_power;
+  }
+
   // map<net, vector<gate>>
   std::unordered_map<std::string, std::vector<std::string>> adj;
   // map<gate, vector<net>>
@@ -88,6 +100,83 @@ double Netlist::ComputeDynamicPower(const Library &lib) const {
   return dynamic_power;
 }
 
+void Netlist::SimulateSwitching(long long num_patterns, uint64_t seed) {
+  const long long num_words = std::max(1LL, (num_patterns + 63) / 64);
+  std::unordered_map<std::string, int> net_ids;
+  const auto net_id = [&](const std::string &net) {
+    return net_ids.emplace(net, net_ids.size()).first->second;
+  };
+
+  // gates in topological order, the same way ComputeDynamicPower visits them
+  std::unordered_map<int, std::vector<int>> readers;  // map<net, gates>
+  std::vector<int> deps(gates_.size());
+  for (size_t i = 0; i < gates_.size(); ++i) {
+    deps[i] = gates_[i].inputs().size();
+    for (const std::string &net : gates_[i].inputs()) {
+      readers[net_id(net)].push_back(i);
+    }
+  }
+  std::vector<int> inputs, order;
+  for (const std::string &net : input_ports_) {
+    inputs.push_back(net_id(net));
+    for (int gate : readers[inputs.back()]) {
+      if (--deps[gate] == 0) order.push_back(gate);
+    }
+  }
+  for (size_t i = 0; i < order.size(); ++i) {
+    for (int gate : readers[net_id(gates_[order[i]].output())]) {
+      if (--deps[gate] == 0) order.push_back(gate);
+    }
+  }
+
+  std::vector<std::vector<int>> fanins(gates_.size());
+  std::vector<int> outputs(gates_.size());
+  for (int gate : order) {
+    for (const std::string &net : gates_[gate].inputs()) {
+      fanins[gate].push_back(net_id(net));
+    }
+    outputs[gate] = net_id(gates_[gate].output());
+  }
+
+  std::vector<uint64_t> values(net_ids.size(), 0);
+  std::vector<uint64_t> toggles(gates_.size(), 0);
+  uint64_t state = seed;
+  for (long long word = 0; word < num_words; ++word) {
+    for (int net : inputs) values[net] = SplitMix64(state);
+    for (int gate : order) {
+      const Cell::Type type = gates_[gate].cell().type();
+      uint64_t value = values[fanins[gate][0]];
+      for (size_t j = 1; j < fanins[gate].size(); ++j) {
+        const uint64_t x = values[fanins[gate][j]];
+        // clang-format off
+        switch (type & Cell::Type::kMaskBaseGate) {
+          case Cell::Type::kOr:  value |= x; break;
+          case Cell::Type::kAnd: value &= x; break;
+          case Cell::Type::kXor: value ^= x; break;
+        }
+        // clang-format on
+      }
+      if (type & Cell::Type::kMaskInverted) value = ~value;
+      values[outputs[gate]] = value;
+      // bit j vs bit j+1 -- 63 comparisons per word
+      toggles[gate] += __builtin_popcountll((value ^ (value >> 1)) &
+                                            0x7fffffffffffffffULL);
+    }
+  }
+
+  // gates never reached (undriven inputs) do not count, as in the analytic
+  // pass
+  switching_.assign(gates_.size(), 0.0);
+  for (int gate : order) switching_[gate] = toggles[gate] / (num_words * 63.0);
+}
+
+void Netlist::SetCell(int gate, Cell &cell) {
+  const std::string &old_name = gates_[gate].cell_name();
+  if (--cell_count_[old_name] == 0) cell_count_.erase(old_name);
+  gates_[gate].set_cell(cell);
+  ++cell_count_[cell.name()];
+}
+
 void Netlist::add_module(std::string &&name) {
   module_name_ = std::move(name);
 
@@ -156,19 +245,5 @@ void Netlist::add_instance(verilog::Instance &&inst) {
 }
 
 std::string Netlist::decode(const std::string &s, int skip) const {
-  std::istringstream in(s);
-  int32_t mem[0x20] = {};
-  std::string segment;
-
-  int i = 0;
-  while (std::getline(in, segment, '_')) {
-    if (skip) {
-      --skip;
-    } else {
-      mem[i++] = std::stoi(segment) - 1234567;
-    }
-  }
-
-  std::string out = (char *)mem;
-  return out;
+  return DecodeModuleName(s, skip);
 }
@@ -36,6 +36,29 @@ class Netlist : protected verilog::ParserVerilogInterface {
    */
   double ComputeDynamicPower(const Library &lib) const;
 
+  /**
+   * @brief Measures each gate's switching rate by random simulation, which
+   * accounts for reconvergent fanout. ComputeDynamicPower() uses these rates
+   * instead of the analytic 2p(1 - p) afterwards. Call after LoadLibrary();
+   * SetCell() keeps the rates as long as the gate type stays the same.
+   *
+   * @param num_patterns number of patterns, rounded up to a multiple of 64
+   * @param seed random seed for the input patterns
+   */
+  void SimulateSwitching(long long num_patterns, uint64_t seed = 1);
+
+  /**
+   * @brief Changes the cell of a gate, e.g. to another variant of the same
+   * gate type. Call after LoadLibrary().
+   *
+   * @param gate index of the gate, in netlist order
+   * @param cell new cell, from the loaded library
+   */
+  void SetCell(int gate, Cell &cell);
+
+  int num_gates() const { return gates_.size(); }
+  const auto &gates() const { return gates_; }
+
   const auto cell_count() const { return cell_count_; }
   const auto clock_period() const { return clock_period_; }
   const auto area_constraint() const { return area_constraint_; }
@@ -85,6 +108,7 @@ class Netlist : protected verilog::ParserVerilogInterface {
   double clock_period_, area_constraint_, power_constraint_;
 
   std::map<std::string, int> cell_count_;
+  std::vector<double> switching_;  // by gate, empty for the analytic rates
 };
 
 #endif  // SRC_NETLIST_HH_
@@ -0,0 +1,64 @@
+/**
+ * @file parallel.hh
+ * @brief Small threading helpers shared by the parallel passes.
+ */
+
+#ifndef SRC_PARALLEL_HH_
+#define SRC_PARALLEL_HH_
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Reusable barrier, blocks until `count` threads have called Wait().
+ */
+class Barrier {
+ public:
+  explicit Barrier(int count) : count_(count) {}
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const int generation = generation_;
+    if (++waiting_ == count_) {
+      waiting_ = 0;
+      ++generation_;
+      cv_.notify_all();
+    } else {
+      cv_.wait(lock, [&] { return generation != generation_; });
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  int count_;
+  int waiting_ = 0;
+  int generation_ = 0;
+};
+
+/**
+ * @brief Runs `f(thread_id)` on `num_threads` threads and joins them.
+ * The calling thread runs as thread 0.
+ */
+template <class F>
+void RunThreads(int num_threads, F&& f) {
+  std::vector<std::thread> threads;
+  for (int t = 1; t < num_threads; ++t) threads.emplace_back(f, t);
+  f(0);
+  for (auto& thread : threads) thread.join();
+}
+
+/**
+ * @brief Splits [begin, end) into `num_threads` contiguous chunks and returns
+ * the chunk belonging to `thread_id`.
+ */
+inline std::pair<int, int> ThreadRange(int begin, int end, int thread_id,
+                                       int num_threads) {
+  const long long n = end - begin;
+  return {begin + (int)(n * thread_id / num_threads),
+          begin + (int)(n * (thread_id + 1) / num_threads)};
+}
+
+#endif  // SRC_PARALLEL_HH_
@@ -0,0 +1,132 @@
+/**
+ * @file random.hh
+ * @brief Small, fast, seedable random number generation. Every mapper (and
+ * every thread or replica) owns its own generator instead of sharing the
+ * global `std::rand` state, so runs are reproducible from one master seed.
+ */
+
+#ifndef SRC_RANDOM_HH_
+#define SRC_RANDOM_HH_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief splitmix64, used to expand seeds and wherever a stateless hash of
+ * (seed, index) is enough.
+ */
+inline uint64_t SplitMix64(uint64_t& state) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/**
+ * @brief xoshiro256** generator with unbiased bounded sampling and buffered
+ * uniform doubles.
+ *
+ * Usage example
+```cpp
+Random rng = Random::Stream(master_seed, thread_id);  // independent streams
+int i = rng.Uniform(n);       // in [0, n), no modulo bias
+double u = rng.UniformReal();  // in [0, 1)
+```
+ */
+class Random {
+ public:
+  explicit Random(uint64_t seed = 1) { Seed(seed); }
+
+  /**
+   * @brief Generator number `stream` of `master_seed`. Streams are 2^128
+   * draws apart, so they never overlap in practice.
+   */
+  static Random Stream(uint64_t master_seed, int stream) {
+    Random rng(master_seed);
+    for (int i = 0; i < stream; ++i) rng.Jump();
+    return rng;
+  }
+
+  void Seed(uint64_t seed) {
+    for (auto& s : s_) s = SplitMix64(seed);
+    buffered_ = 0;
+  }
+
+  uint64_t operator()() {
+    const uint64_t result = Rotl(s_[1] * 5, 7) * 9;
+    const uint64_t t = s_[1] << 17;
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = Rotl(s_[3], 45);
+    return result;
+  }
+
+  /**
+   * @brief Uniform integer in [0, n), Lemire's multiply-shift with
+   * rejection (no modulo bias). n must be positive.
+   */
+  uint32_t Uniform(uint32_t n) {
+    uint64_t m = (uint64_t)(uint32_t)((*this)() >> 32) * n;
+    if ((uint32_t)m < n) {
+      const uint32_t threshold = -n % n;
+      while ((uint32_t)m < threshold) {
+        m = (uint64_t)(uint32_t)((*this)() >> 32) * n;
+      }
+    }
+    return m >> 32;
+  }
+
+  /**
+   * @brief Uniform double in [0, 1) with 53 random bits. Served from a
+   * buffer refilled in batches, for the SA acceptance test.
+   */
+  double UniformReal() {
+    if (buffered_ == 0) {
+      for (int i = 0; i < kBufferSize; ++i) buffer_[i] = ToReal((*this)());
+      buffered_ = kBufferSize;
+    }
+    return buffer_[--buffered_];
+  }
+
+  /**
+   * @brief Fills `out` with `n` uniform doubles in [0, 1).
+   */
+  void UniformReals(double* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = ToReal((*this)());
+  }
+
+  /**
+   * @brief Advances the state by 2^128 draws.
+   */
+  void Jump() {
+    static constexpr uint64_t kJump[] = {
+        0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL,
+        0x39abdc4529b1661cULL};
+    uint64_t s[4] = {0, 0, 0, 0};
+    for (uint64_t jump : kJump) {
+      for (int b = 0; b < 64; ++b) {
+        if (jump & (1ULL << b)) {
+          for (int i = 0; i < 4; ++i) s[i] ^= s_[i];
+        }
+        (*this)();
+      }
+    }
+    for (int i = 0; i < 4; ++i) s_[i] = s[i];
+    buffered_ = 0;
+  }
+
+ private:
+  static constexpr int kBufferSize = 64;
+
+  static uint64_t Rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+  static double ToReal(uint64_t x) { return (x >> 11) * 0x1.0p-53; }
+
+  uint64_t s_[4];
+  double buffer_[kBufferSize];
+  int buffered_ = 0;  // unread values at the front of buffer_
+};
+
+#endif  // SRC_RANDOM_HH_
@@ -0,0 +1,173 @@
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "island.hh"
+#include "simulated_annealing_mapper.hh"
+#include "temperature_schedule.hh"
+#include "utils.hh"
+
+int32_t main(int argc, char** argv) {
+  uint64_t seed = std::time(NULL);
+  int replicas = 1;  // > 1 runs parallel tempering
+  double budget = 0;  // seconds, > 0 runs against a deadline
+  std::string telemetry;  // JSON lines file, off if empty
+  std::string checkpoint = "sa.checkpoint";
+  bool resume = false;  // continue from the checkpoint
+  int islands = 0;  // > 0 coordinates that many islands
+  int local_islands = -1;  // forked here, the rest connect with -worker
+  std::string island_address = "unix:/tmp/sa-" + std::to_string(getpid()) +
+                               ".sock";
+  std::string worker;  // coordinator address, runs as an island if set
+  long long sim_patterns = 0;  // > 0 simulates the switching activity
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--resume") resume = true;
+    if (i + 1 == argc) break;
+    if (arg == "-seed") seed = std::stoull(argv[++i]);
+    if (arg == "-replicas") replicas = std::stoi(argv[++i]);
+    if (arg == "-time") budget = std::stod(argv[++i]);
+    if (arg == "-telemetry") telemetry = argv[++i];
+    if (arg == "-checkpoint") checkpoint = argv[++i];
+    if (arg == "-islands") islands = std::stoi(argv[++i]);
+    if (arg == "-local-islands") local_islands = std::stoi(argv[++i]);
+    if (arg == "-island-address") island_address = argv[++i];
+    if (arg == "-worker") worker = argv[++i];
+    if (arg == "-sim-patterns") sim_patterns = std::stoll(argv[++i]);
+  }
+  std::cout << "seed=" << seed << std::endl;  // rerun with -seed to reproduce
+  InstallTerminationHandler();  // SIGTERM still writes out the best mapping
+
+  SimulatedAnnealingMapper mapper("a_out.v", std::cout);
+  mapper.set_seed(seed);
+  mapper.set_telemetry(telemetry);
+  mapper.set_checkpoint(checkpoint);
+  mapper.set_simulation_patterns(sim_patterns);
+  mapper.LoadCached("design1.aig", "lib1.json", "design1.snapshot");
+  mapper.Initialize();
+  if (!resume) {
+    mapper.WriteVerilogABC("a_logic_before.v");
+  } else if (!mapper.Resume(checkpoint)) {
+    std::cerr << "cannot resume from " << checkpoint << std::endl;
+    return 1;
+  }
+
+  static const auto cost =
+      [](const SimulatedAnnealingMapper& mapper) -> double {
+    const double area = mapper.area();
+    const double power = mapper.power();
+    const double dynamic_power = mapper.dynamic_power();
+    double penalty = 0;
+    // if (area >= 500 || power > 0.15)
+    //   penalty = 1e7 * (area / 500 + power / 0.15);
+    return area + power;
+    return std::pow(penalty + (1 + area) * (1 + power + dynamic_power), 0.5);
+  };
+
+  typedef SimulatedAnnealingMapper SAM;
+  // moves are proposals: the cost sees their delta, and only accepted ones
+  // are applied to the mapper, so the transitions never see undo == true
+  static const auto add_random_gate = [](SAM& mapper, bool) -> void {
+    mapper.ProposeAddRandomGate();
+  };
+
+  static const auto change_aig_gate = [](SAM& mapper, bool) -> void {
+    int i = mapper.rng().Uniform(2 * mapper.sz_v());
+    Cell::Type type = i & 1 ? Cell::Type::kNot : Cell::Type::kAnd;
+    auto new_cell = choice(mapper.library().GetCellsByType(type), mapper.rng());
+    mapper.ProposeChangeAIGNodeGate(i, new_cell);
+  };
+
+  // other moves: change_aig_gate, ProposeRemoveBinaryGate(RandomActiveGate())
+  const MoveSet transitions(add_random_gate);
+
+  // islands anneal on their own with both moves, the coordinator only
+  // collects and migrates their mappings
+  if (!worker.empty()) {
+    return RunIslandWorker(mapper, worker, cost,
+                           {change_aig_gate, add_random_gate})
+               ? 0
+               : 1;
+  }
+  if (islands > 0) {
+    const int listen_fd = ListenSocket(island_address);
+    if (listen_fd < 0) {
+      std::cerr << "cannot listen on " << island_address << std::endl;
+      return 1;
+    }
+    std::vector<pid_t> children;
+    if (local_islands < 0) local_islands = islands;
+    for (int i = 0; i < local_islands; ++i) {
+      const pid_t pid = fork();
+      if (pid == 0) {
+        close(listen_fd);
+        std::cout.setstate(std::ios::badbit);  // the coordinator reports
+        _exit(RunIslandWorker(mapper, island_address, cost,
+                              {change_aig_gate, add_random_gate})
+                  ? 0
+                  : 1);
+      }
+      if (pid > 0) children.push_back(pid);
+    }
+    IslandOptions options;
+    options.num_islands = islands - local_islands + children.size();
+    RunIslandCoordinator(mapper, listen_fd, options, "a_out.v");
+    close(listen_fd);
+    if (island_address.rfind("unix:", 0) == 0) {
+      unlink(island_address.substr(5).c_str());
+    }
+    for (pid_t pid : children) waitpid(pid, nullptr, 0);
+    mapper.WriteVerilogABC("a_logic_after.v");
+    return 0;
+  }
+
+  if (replicas > 1) {
+    mapper.set_time_budget(budget);
+    mapper.RunParallelTempering(cost, {change_aig_gate, add_random_gate},
+                                1e-3, 1, 1e5, replicas);
+    mapper.WriteVerilogABC("a_logic_after.v");
+    return 0;
+  }
+
+  // each phase calibrates its initial temperature on a short warm-up
+  const MoveSet change_gates(change_aig_gate);
+  // the budget is split by the time each phase's iterations take at its
+  // measured move rate: add_random_gate moves are far cheaper, and given
+  // more than its iterations' worth the second phase saturates the mapping
+  // and never cools
+  const auto start = std::chrono::steady_clock::now();
+  const auto seconds_since = [](std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         t0)
+        .count();
+  };
+  if (budget > 0) {
+    const auto t0 = std::chrono::steady_clock::now();
+    mapper.SampleUphill(cost, change_gates, 500);
+    const double change_seconds = 1e5 * seconds_since(t0) / 500;
+    const auto t1 = std::chrono::steady_clock::now();
+    mapper.SampleUphill(cost, transitions, 500);
+    const double add_seconds = 1e4 * seconds_since(t1) / 500;
+    mapper.set_time_budget(budget * change_seconds /
+                           (change_seconds + add_seconds));
+  }
+  AdaptiveSchedule change_schedule(1e5);
+  change_schedule.Calibrate(mapper.SampleUphill(cost, change_gates, 500));
+  mapper.Run(change_schedule, cost, change_gates, 1e-2, 1e5);
+
+  // what the first phase left, 0 would mean iteration mode
+  if (budget > 0) {
+    mapper.set_time_budget(std::max(1e-3, budget - seconds_since(start)));
+  }
+  AdaptiveSchedule schedule(1e4);
+  schedule.Calibrate(mapper.SampleUphill(cost, transitions, 500));
+  mapper.Run(schedule, cost, transitions, 1, 1e4);
+  mapper.WriteVerilogABC("a_logic_after.v");
+}
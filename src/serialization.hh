@@ -0,0 +1,301 @@
+/**
+ * @file serialization.hh
+ * @brief Binary (de)serialization helpers for snapshots of preprocessed data.
+ *
+ * Types opt in with a member `template <class Archive> void Serialize(Archive&
+ * ar)` that passes every field to `ar(...)`, the same function then both
+ * writes and reads. Numbers and vectors of them are stored little-endian, so
+ * messages built from them (see island.hh) read the same on any machine.
+ * Other trivially copyable values are copied as raw bytes, so snapshots are
+ * only valid for the machine that wrote them.
+ */
+
+#ifndef SRC_SERIALIZATION_HH_
+#define SRC_SERIALIZATION_HH_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool kBigEndianHost = true;
+#else
+constexpr bool kBigEndianHost = false;
+#endif
+
+/**
+ * @brief Whether the archives byte-swap `T` on a big-endian host.
+ */
+template <class T>
+constexpr bool kSwapsBytes =
+    kBigEndianHost && std::is_arithmetic_v<T> && sizeof(T) > 1;
+
+/**
+ * @brief Converts a number between host and little-endian byte order (in
+ * either direction, it is its own inverse). A no-op on little-endian hosts.
+ */
+template <class T>
+T LittleEndian(T x) {
+  if constexpr (kSwapsBytes<T>) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &x, sizeof(T));
+    std::reverse(bytes, bytes + sizeof(T));
+    std::memcpy(&x, bytes, sizeof(T));
+  }
+  return x;
+}
+
+/**
+ * @brief Read-only memory mapping of a whole file. Empty if it can't be opened.
+ */
+class MappedFile {
+ public:
+  explicit MappedFile(const std::filesystem::path& file) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        data_ = static_cast<const char*>(data);
+        size_ = st.st_size;
+        madvise(data, size_, MADV_SEQUENTIAL);
+      }
+    }
+    close(fd);
+  }
+  ~MappedFile() {
+    if (data_) munmap(const_cast<char*>(data_), size_);
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+/**
+ * @brief Fast 64-bit content hash (not cryptographic), used to detect source
+ * file changes.
+ */
+inline uint64_t HashBytes(const char* data, size_t size, uint64_t seed = 0) {
+  const uint64_t kMul = 0x9e3779b97f4a7c15ULL;
+  uint64_t h = seed ^ (size * kMul);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t w;
+    std::memcpy(&w, data + i, 8);
+    h = (h ^ w) * kMul;
+    h ^= h >> 29;
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, data + i, size - i);
+  h = (h ^ tail) * kMul;
+  return h ^ (h >> 32);
+}
+
+inline uint64_t HashFile(const std::filesystem::path& file, uint64_t seed = 0) {
+  MappedFile mapped(file);
+  return HashBytes(mapped.data(), mapped.size(), seed);
+}
+
+/**
+ * @brief Archive that appends values to a byte buffer.
+ */
+class BinaryWriter {
+ public:
+  template <class... Ts>
+  void operator()(const Ts&... xs) {
+    (Write(xs), ...);
+  }
+
+  /**
+   * @brief Writes the buffer to `file` atomically (temp file + rename).
+   *
+   * @return true if successful
+   */
+  bool Save(const std::filesystem::path& file) const {
+    std::filesystem::path tmp = file;
+    tmp += ".tmp";
+    {
+      std::ofstream fout(tmp, std::ios::binary);
+      fout.write(buffer_.data(), buffer_.size());
+      if (!fout) return false;
+    }
+    std::error_code error;
+    std::filesystem::rename(tmp, file, error);
+    return !error;
+  }
+
+  const std::string& buffer() const { return buffer_; }
+
+ private:
+  template <class T>
+  void Write(const T& x) {
+    if constexpr (kSwapsBytes<T>) {
+      const T y = LittleEndian(x);
+      buffer_.append(reinterpret_cast<const char*>(&y), sizeof(T));
+    } else if constexpr (std::is_trivially_copyable_v<T>) {
+      buffer_.append(reinterpret_cast<const char*>(&x), sizeof(T));
+    } else {
+      const_cast<T&>(x).Serialize(*this);
+    }
+  }
+  void Write(const std::string& s) {
+    Write((uint64_t)s.size());
+    buffer_.append(s);
+  }
+  template <class T>
+  void Write(const std::vector<T>& v) {
+    Write((uint64_t)v.size());
+    if constexpr (kSwapsBytes<T>) {
+      for (const T& x : v) Write(x);
+    } else if constexpr (std::is_trivially_copyable_v<T>) {
+      buffer_.append(reinterpret_cast<const char*>(v.data()),
+                     v.size() * sizeof(T));
+    } else {
+      for (const auto& x : v) Write(x);
+    }
+  }
+  template <class K, class V>
+  void Write(const std::pair<K, V>& p) {
+    Write(p.first);
+    Write(p.second);
+  }
+  template <class K, class V>
+  void Write(const std::map<K, V>& m) {
+    Write((uint64_t)m.size());
+    for (const auto& p : m) Write(p);
+  }
+  template <class K, class V>
+  void Write(const std::unordered_map<K, V>& m) {
+    Write((uint64_t)m.size());
+    for (const auto& p : m) Write(p);
+  }
+
+  std::string buffer_;
+};
+
+/**
+ * @brief Archive that reads values back from a byte range (e.g. a
+ * MappedFile). After a short read, `ok()` is false and values are garbage.
+ */
+class BinaryReader {
+ public:
+  BinaryReader(const char* data, size_t size) : p_(data), end_(data + size) {}
+
+  template <class... Ts>
+  void operator()(Ts&... xs) {
+    (Read(xs), ...);
+  }
+
+  bool ok() const { return ok_; }
+  bool at_end() const { return p_ == end_; }
+
+ private:
+  bool Take(void* out, size_t n) {
+    if (!ok_ || (size_t)(end_ - p_) < n) return ok_ = false;
+    std::memcpy(out, p_, n);
+    p_ += n;
+    return true;
+  }
+  template <class T>
+  void Read(T& x) {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      Take(&x, sizeof(T));
+      if constexpr (kSwapsBytes<T>) x = LittleEndian(x);
+    } else {
+      x.Serialize(*this);
+    }
+  }
+  void Read(std::string& s) {
+    uint64_t n = 0;
+    Read(n);
+    if (!ok_ || (size_t)(end_ - p_) < n) {
+      ok_ = false;
+      return;
+    }
+    s.assign(p_, n);
+    p_ += n;
+  }
+  template <class T>
+  void Read(std::vector<T>& v) {
+    uint64_t n = 0;
+    Read(n);
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      if (!ok_ || (size_t)(end_ - p_) / sizeof(T) < n) {
+        ok_ = false;
+        return;
+      }
+      v.resize(n);
+      Take(v.data(), n * sizeof(T));
+      if constexpr (kSwapsBytes<T>) {
+        for (T& x : v) x = LittleEndian(x);
+      }
+    } else {
+      v.clear();
+      for (uint64_t i = 0; i < n && ok_; ++i) Read(v.emplace_back());
+    }
+  }
+  template <class K, class V>
+  void Read(std::pair<K, V>& p) {
+    Read(p.first);
+    Read(p.second);
+  }
+  template <class K, class V>
+  void Read(std::map<K, V>& m) {
+    uint64_t n = 0;
+    Read(n);
+    m.clear();
+    for (uint64_t i = 0; i < n && ok_; ++i) {
+      std::pair<K, V> p;
+      Read(p);
+      m.insert(std::move(p));
+    }
+  }
+  template <class K, class V>
+  void Read(std::unordered_map<K, V>& m) {
+    uint64_t n = 0;
+    Read(n);
+    m.clear();
+    for (uint64_t i = 0; i < n && ok_; ++i) {
+      std::pair<K, V> p;
+      Read(p);
+      m.insert(std::move(p));
+    }
+  }
+
+  const char* p_;
+  const char* end_;
+  bool ok_ = true;
+};
+
+/**
+ * @brief Whether `T` opts in with a Serialize(Archive&) member.
+ */
+template <class T, class = void>
+struct IsSerializable : std::false_type {};
+template <class T>
+struct IsSerializable<T, std::void_t<decltype(std::declval<T&>().Serialize(
+                             std::declval<BinaryWriter&>()))>>
+    : std::true_type {};
+
+#endif  // SRC_SERIALIZATION_HH_
@@ -2,167 +2,242 @@
 
 #include <time.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstring>
 #include <cmath>
 #include <iomanip>
 #include <iostream>
-#include <random>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
 
+#include "parallel.hh"
 #include "utils.hh"
 
-double SimulatedAnnealingMapper::AcceptProbability(double E, double Ep,
-                                                   double T) {
-  if (Ep < E) return 1;
-  return std::exp(-(Ep - E) / T);
+double SimulatedAnnealingMapper::Run(
+    const TemperatureSchedule& temperature_schedule,
+    const CostEstimator& cost_estimator,
+    const std::vector<Transition>& transitions, double initial_temperature,
+    int iterations, int runs) {
+  return Anneal(
+      temperature_schedule, cost_estimator,
+      [&](long long it) {
+        const int move = it % transitions.size();
+        transitions[move](*this, false);
+        return move;
+      },
+      initial_temperature, iterations, runs);
 }
 
-void SimulatedAnnealingMapper::Run(TemperatureSchedule temperature_schedule,
-                                   CostEstimator cost_estimator,
-                                   std::vector<Transition> transitions,
-                                   double initial_temperature, int iterations,
-                                   int runs) {
-  double E = cost_estimator(*this);  // current energy
-  double Ep;                         // E' (E prime) -- energy in updated state
-  double E_low = E;                  // lowest energy
-  double T;                          // temperature
+namespace {
 
-  time_t last_update = time(NULL);
+constexpr char kCheckpointMagic[8] = {'S', 'A', 'C', 'K', 'P', 'T', 0, 0};
 
-  for (int tn = 0; tn < runs; ++tn) {
-    E = cost_estimator(*this);
-    bool write_ready = false;
-    for (int it = 0; it < iterations; ++it) {
-      // progress display BEGIN_SECTION
-      if (it % 1000 == 0) {
-        write_ready = true;
-        os_ << std::fixed << "epoch=" << std::setw(5) << tn
-            << " iter=" << std::setw(10) << it << " T=" << std::setw(10)
-            << std::setprecision(7) << T << std::scientific
-            << " curr = " << std::setw(10) << E << " best = " << std::setw(10)
-            << E_low << std::endl;
-        time_t current_time = time(NULL);
-        if (it && current_time <= last_update + 10) {
-          std::cout << "\u001b[1F\u001b[1K";
-        } else {
-          last_update = current_time;
-        }
-      }
-      // progress display END_SECTION
-
-      T = temperature_schedule(initial_temperature, it);
-
-      // apply change
-      int transition_id = it % transitions.size();
-      const auto& transition = transitions[transition_id];
-      transition(*this, false);
-
-      Ep = cost_estimator(*this);  // compute new temperature
-      if (AcceptProbability(E, Ep, T) * RAND_MAX >= std::rand()) {
-        E = Ep;
-        if (E < E_low) {  // best seen so far?
-          E_low = E;
-          WriteMapping(output_path_);
-          // if (write_ready) os_ << it << std::endl;
-        }
-      } else {
-        // undo change
-        transition(*this, true);
-      }
-    }
-  }
+}  // namespace
 
-  os_ << std::endl;
+bool SimulatedAnnealingMapper::SaveCheckpoint(const AnnealPoint& point) const {
+  BinaryWriter ar;
+  ar(kCheckpointMagic, kCheckpointVersion);
+  ar(point.call, point.finished, point.run, point.it, point.E_low,
+     point.elapsed, point.schedule);
+  SaveState(ar);
+  return ar.Save(checkpoint_path_);
 }
 
-int32_t main() {
-  std::srand(0);
-  std::srand(std::time(NULL));
-
-  SimulatedAnnealingMapper mapper("a_out.v", std::cout);
-  mapper.Load("design1.aig");
-  mapper.LoadLibrary("lib1.json");
-  mapper.Initialize();
-  mapper.WriteVerilogABC("a_logic_before.v");
-
-  static const SimulatedAnnealingMapper::TemperatureSchedule
-      temperature_schedule =
-          [](double t1, int i) -> double { return t1 * 0.2 / (i / 10); };
-
-  static const auto cost =
-      [](const SimulatedAnnealingMapper& mapper) -> double {
-    const double area = mapper.area();
-    const double power = mapper.power();
-    const double dynamic_power = mapper.dynamic_power();
-    double penalty = 0;
-    // if (area >= 500 || power > 0.15)
-    //   penalty = 1e7 * (area / 500 + power / 0.15);
-    return area + power;
-    return std::pow(penalty + (1 + area) * (1 + power + dynamic_power), 0.5);
-  };
+bool SimulatedAnnealingMapper::Resume(const std::filesystem::path& file) {
+  MappedFile mapped(file);
+  if (mapped.empty()) return false;
+  BinaryReader ar(mapped.data(), mapped.size());
+  char magic[sizeof(kCheckpointMagic)];
+  uint32_t version = 0;
+  ar(magic, version);
+  if (!ar.ok() || std::memcmp(magic, kCheckpointMagic, sizeof(magic)) != 0 ||
+      version != kCheckpointVersion) {
+    return false;
+  }
+  AnnealPoint point;
+  ar(point.call, point.finished, point.run, point.it, point.E_low,
+     point.elapsed, point.schedule);
+  if (!ar.ok() || !LoadState(ar) || !ar.at_end()) return false;
+  point.rng = rng();
+  resume_ = std::move(point);
+  anneal_calls_ = 0;
+  return true;
+}
 
-  typedef SimulatedAnnealingMapper SAM;
-  typedef const SimulatedAnnealingMapper::Transition Transition;
-  static Transition add_random_gate = [](SAM& mapper, bool undo) -> void {
-    if (!undo) {
-      mapper.AddRandomGate();
-    } else {
-      mapper.UndoGateAdd();
-    }
+double SimulatedAnnealingMapper::RunParallelTempering(
+    CostEstimator cost_estimator, std::vector<Transition> transitions,
+    double min_temperature, double max_temperature, int iterations,
+    int num_replicas, int swap_interval) {
+  assert(!in_transaction() && min_temperature > 0);
+  num_replicas = std::max(num_replicas, 1);
+  swap_interval = std::max(swap_interval, 1);
+
+  // geometric ladder, temperatures[0] is the coldest
+  std::vector<double> temperatures(num_replicas, min_temperature);
+  for (int k = 1; k < num_replicas; ++k) {
+    temperatures[k] =
+        min_temperature * std::pow(max_temperature / min_temperature,
+                                   (double)k / (num_replicas - 1));
+  }
+
+  const uint64_t seed = rng()();
+  std::vector<std::unique_ptr<SimulatedAnnealingMapper>> replicas;
+  std::vector<double> energy(num_replicas);
+  for (int r = 0; r < num_replicas; ++r) {
+    replicas.push_back(std::make_unique<SimulatedAnnealingMapper>(*this));
+    replicas[r]->set_rng(Random::Stream(seed, r));
+    energy[r] = cost_estimator(*replicas[r]);
+  }
+
+  // configurations are exchanged by exchanging temperatures instead:
+  // replica_at[k] runs at temperatures[k] and level[r] is its inverse
+  std::vector<int> replica_at(num_replicas);
+  std::vector<int> level(num_replicas);
+  for (int r = 0; r < num_replicas; ++r) replica_at[r] = level[r] = r;
+
+  std::mutex best_mutex;  // guards best, reached and writes of unsaved
+  double best = energy[0];
+  bool reached = best <= target_cost_;
+  bool finished = reached;  // only written by thread 0 between barriers
+
+  // the best mapping is captured lazily, as in Run(): unsaved is the replica
+  // sitting on a best mapping the writer doesn't have yet, uncaptured the one
+  // sitting on a best mapping not encoded into best_mapping yet, which this
+  // mapper takes over at the end
+  std::optional<MappingWriter> writer;
+  if (!output_path_.empty()) {
+    writer.emplace(*this, output_path_, write_interval_);
+  }
+  std::atomic<int> unsaved(-1);
+  std::atomic<int> uncaptured(-1);
+  std::string best_mapping;
+  const auto capture = [&best_mapping](SimulatedAnnealingMapper& m) {
+    BinaryWriter ar;
+    m.EncodeMapping(ar);
+    best_mapping = ar.buffer();
   };
+  capture(*this);
+
+  // in deadline mode rounds go on until the deadline, and thread 0 checks it
+  // between rounds
+  std::optional<Deadline> deadline;
+  if (time_budget_ > 0) {
+    const Deadline::Clock::time_point now = Deadline::Clock::now();
+    deadline.emplace(
+        now, now + Deadline::Duration(time_budget_), 1,
+        [&writer] { return writer ? 2 * writer->write_seconds() : 0; });
+  }
 
-  static Transition remove_random_gate = [](SAM& mapper, bool undo) -> void {
-    static const IterativeTechnologyMapper::GateMapping* mapping_ptr = 0;
-    if (!undo) {
-      mapping_ptr = nullptr;
-
-      // precompute this later
-      int mapped_gates = 0;
-      for (const auto& g : mapper.gates()) mapped_gates += g.active;
-      
-      if (mapped_gates == 0) return; // can't do anything
-
-      // can use something like a page table later?
-      int nth_gate = std::rand() % mapped_gates;
-      int g = 0;
-      while (nth_gate) {
-        nth_gate -= mapper.gates().at(g).active;
-        ++g;
-      }
-      
-      // update static variable
-      mapping_ptr = mapper.aig_gates().at(g).mapping;
-      mapper.RemoveBinaryGate(g);
-    } else {
-      // it's just null sometimes...
-      if (mapping_ptr) {
-        mapper.AddBinaryGate(mapping_ptr);
+  long long swaps_tried = 0, swaps_accepted = 0;
+  const int num_rounds = (iterations + swap_interval - 1) / swap_interval;
+  const int display_rounds = std::max(1, 1000 / swap_interval);
+  time_t last_update = time(NULL);
+
+  Barrier barrier(num_replicas);
+  RunThreads(num_replicas, [&](int r) {
+    auto& mapper = *replicas[r];
+    double E = energy[r];
+    double E_low = E;  // lowest energy of this replica
+    for (long long round = 0; (deadline || round < num_rounds) && !finished;
+         ++round) {
+      const double T = temperatures[level[r]];
+      const long long first = round * swap_interval;
+      const long long last = deadline ? first + swap_interval
+                                      : std::min<long long>(
+                                            iterations, first + swap_interval);
+      for (long long it = first; it < last; ++it) {
+        mapper.Begin();
+        transitions[it % transitions.size()](mapper, false);
+        const double Ep = cost_estimator(mapper);
+        if (mapper.rng().UniformReal() < AcceptProbability(E, Ep, T)) {
+          if (Ep >= E_low &&
+              (unsaved.load(std::memory_order_relaxed) == r ||
+               uncaptured.load(std::memory_order_relaxed) == r)) {
+            std::lock_guard<std::mutex> lock(best_mutex);
+            if (unsaved == r) {  // leaving the best, capture it pre-Commit
+              writer->Submit(mapper);
+              unsaved = -1;
+            }
+            if (uncaptured == r) {
+              capture(mapper);
+              uncaptured = -1;
+            }
+          }
+          mapper.Commit();
+          E = Ep;
+          if (E < E_low) {
+            E_low = E;
+            std::lock_guard<std::mutex> lock(best_mutex);
+            if (E < best) {  // best seen by any replica?
+              best = E;
+              reached = best <= target_cost_;
+              uncaptured = r;
+              if (writer && writer->due()) {
+                writer->Submit(mapper);
+                unsaved = -1;
+              } else if (writer) {
+                unsaved = r;
+              }
+            }
+          }
+        } else {
+          mapper.Rollback();
+        }
       }
-    }
-  };
+      energy[r] = E;
+      barrier.Wait();
+
+      if (r == 0) {
+        // even rounds pair (0, 1), (2, 3), .. and odd rounds (1, 2), ..
+        for (int k = round & 1; k + 1 < num_replicas; k += 2) {
+          const int a = replica_at[k];
+          const int b = replica_at[k + 1];
+          const double x = (1 / temperatures[k] - 1 / temperatures[k + 1]) *
+                           (energy[a] - energy[b]);
+          ++swaps_tried;
+          if (x >= 0 || rng().UniformReal() < std::exp(x)) {
+            ++swaps_accepted;
+            std::swap(replica_at[k], replica_at[k + 1]);
+            level[a] = k + 1;
+            level[b] = k;
+          }
+        }
 
-  static Transition change_aig_gate = [](SAM& mapper, bool undo) -> void {
-    static int i = -1;
-    static const Cell* old_cell = nullptr;
-    if (!undo) {
-      i = std::rand() % (2 * mapper.sz_v());
-      old_cell = mapper.aig_nodes().at(i).cell;
-      Cell::Type type = i & 1 ? Cell::Type::kNot : Cell::Type::kAnd;
-      auto new_cell = choice(mapper.library().GetCellsByType(type));
-      mapper.ChangeAIGNodeGate(i, new_cell);
-    } else {
-      mapper.ChangeAIGNodeGate(i, old_cell);
+        std::lock_guard<std::mutex> lock(best_mutex);
+        finished = reached || TerminationRequested() ||
+                   (deadline && !deadline->Tick(round));
+        if (round % display_rounds == 0) {
+          os_ << std::scientific << "iter=" << std::setw(10) << last
+              << " cold = " << std::setw(10) << energy[replica_at[0]]
+              << " best = " << std::setw(10) << best << std::fixed
+              << " swaps = " << std::setprecision(3)
+              << (double)swaps_accepted / std::max(1LL, swaps_tried)
+              << std::endl;
+          time_t current_time = time(NULL);
+          if (round && current_time <= last_update + 10) {
+            os_ << "\u001b[1F\u001b[1K";
+          } else {
+            last_update = current_time;
+          }
+        }
+      }
+      barrier.Wait();
     }
-  };
+  });
+  os_ << std::endl;
+  if (unsaved != -1) writer->Submit(*replicas[unsaved]);  // still at the best
+  writer.reset();  // flush before this mapper is reassigned
 
-  const std::vector<SimulatedAnnealingMapper::Transition> transitions = {
-      add_random_gate,
-      // remove_random_gate,
-      // change_aig_gate,
-  };
+  if (uncaptured != -1) capture(*replicas[uncaptured]);
 
-  // mapper.Run(temperature_schedule, cost, {add_random_gate}, 100, 1000);
-  mapper.Run(temperature_schedule, cost, {change_aig_gate}, 1e-2, 1e5);
-  mapper.Run(temperature_schedule, cost, transitions, 1, 1e4);
-  // mapper.Run(temperature_schedule, cost, transitions, 0, 1e6);
-  // mapper.Run(temperature_schedule, cost, {add_random_gate}, 100, 100000);
-  mapper.WriteVerilogABC("a_logic_after.v");
+  BinaryReader ar(best_mapping.data(), best_mapping.size());
+  const bool decoded = DecodeMapping(ar);
+  assert(decoded && "A mapping of this design decodes.");
+  (void)decoded;
+  return best;
 }
@@ -1,17 +1,109 @@
 #ifndef SRC_SIMULATED_ANNEALING_MAPPER_HH_
 #define SRC_SIMULATED_ANNEALING_MAPPER_HH_
 
+#include <time.h>
+
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <functional>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "deadline.hh"
 #include "iterative_technology_mapper.hh"
+#include "mapping_writer.hh"
+#include "serialization.hh"
+#include "telemetry.hh"
+#include "temperature_schedule.hh"
+
+/**
+ * @brief A move picked `W` times per round of its MoveSet.
+ */
+template <int W, class F>
+struct WeightedMove {
+  static_assert(W > 0, "Weights are positive.");
+  F f;
+};
+
+template <int W, class F>
+WeightedMove<W, std::decay_t<F>> Weighted(F&& f) {
+  return {std::forward<F>(f)};
+}
+
+/**
+ * @brief A fixed set of SA moves, each a callable taking `(mapper, undo)`,
+ * with weights known at compile time (1 unless wrapped in Weighted<W>).
+ * Iteration `it` applies the move in slot `it % total weight`, so moves are
+ * interleaved round robin like the std::function Run().
+ */
+template <class... Moves>
+class MoveSet {
+ public:
+  explicit MoveSet(Moves... moves) : moves_(std::move(moves)...) {}
+
+  /**
+   * @return index of the move applied
+   */
+  template <class Mapper>
+  int Apply(Mapper& mapper, long long it) {
+    const int move = kSlots[it % kTotalWeight];
+    Dispatch(mapper, move, std::index_sequence_for<Moves...>());
+    return move;
+  }
+
+ private:
+  template <class F>
+  struct Weight : std::integral_constant<int, 1> {};
+  template <int W, class F>
+  struct Weight<WeightedMove<W, F>> : std::integral_constant<int, W> {};
+
+  static constexpr int kTotalWeight = (0 + ... + Weight<Moves>::value);
+
+  static constexpr std::array<uint8_t, kTotalWeight> MakeSlots() {
+    std::array<uint8_t, kTotalWeight> slots{};
+    constexpr int weights[] = {Weight<Moves>::value...};
+    int k = 0;
+    for (size_t m = 0; m < sizeof...(Moves); ++m) {
+      for (int w = 0; w < weights[m]; ++w) slots[k++] = m;
+    }
+    return slots;
+  }
+  static constexpr std::array<uint8_t, kTotalWeight> kSlots = MakeSlots();
+
+  template <class Mapper, class F>
+  static void Call(F& move, Mapper& mapper) {
+    move(mapper, false);
+  }
+  template <class Mapper, int W, class F>
+  static void Call(WeightedMove<W, F>& move, Mapper& mapper) {
+    move.f(mapper, false);
+  }
+  template <class Mapper, size_t... Is>
+  void Dispatch(Mapper& mapper, int slot, std::index_sequence<Is...>) {
+    ((slot == (int)Is ? (Call(std::get<Is>(moves_), mapper), 0) : 0), ...);
+  }
+
+  std::tuple<Moves...> moves_;
+};
 
 /**
  * Technology mapping using simulated annealing.
  *
- * TODO: use time based temperature schedule instead of iteration based (?)
+ * Runs are iteration based, or with set_time_budget() deadline based: the
+ * schedule is then stretched over the budget, whatever the moves per second
+ * on the design at hand.
  */
 class SimulatedAnnealingMapper : public IterativeTechnologyMapper {
  public:
@@ -27,18 +119,158 @@ class SimulatedAnnealingMapper : public IterativeTechnologyMapper {
    * `runs` runs in total.
    *
    * @param temperature_schedule takes `(double)initial_temperature`,
-   * `(int)iteration` and outputs `(double)temperature`
+   * `(int)iteration` and outputs `(double)temperature`. Schedules with an
+   * `Observe(bool accepted)` member (see AdaptiveSchedule) get told the
+   * outcome of every uphill move, and are Restart()ed at the start of each
+   * run, in the templated overload.
    * @param cost_estimator used to compute energy. takes an instance of
    * `SimulatedAnnealingMapper` and returns `(double)cost`
-   * @param transitions a vector of invertible transitions. each transition
-   * takes `SimulatedAnnealingMapper` and `(bool)undo`.
+   * @param transitions a vector of transitions, applied round robin. each
+   * transition takes `SimulatedAnnealingMapper` and `(bool)undo`. Each step
+   * runs inside a mapper transaction and rejected steps are rolled back, so
+   * `undo` is always false.
    * @param initial_temperature
    * @param iterations
    * @param runs
+   * @return lowest energy seen. Afterwards this mapper holds the lowest
+   * energy mapping seen since the call (or the resume) started.
+   */
+  double Run(const TemperatureSchedule& temperature_schedule,
+             const CostEstimator& cost_estimator,
+             const std::vector<Transition>& transitions,
+             double initial_temperature, int iterations, int runs = 1);
+
+  /**
+   * @brief Same as above, with the schedule, cost and moves as compile-time
+   * policies (any callables) so that the whole iteration can be inlined.
+   *
+   * Usage example
+```cpp
+mapper.Run(schedule, cost,
+           MoveSet(Weighted<3>(change_aig_gate), add_random_gate), 1, 1e5);
+```
+   */
+  template <class Schedule, class Cost, class... Moves>
+  double Run(Schedule&& temperature_schedule, Cost&& cost_estimator,
+             MoveSet<Moves...> moves, double initial_temperature,
+             int iterations, int runs = 1) {
+    return Anneal(
+        temperature_schedule, cost_estimator,
+        [&](long long it) { return moves.Apply(*this, it); },
+        initial_temperature,
+        iterations, runs);
+  }
+
+  /**
+   * @brief Warm-up for calibrating a schedule: tries `samples` moves without
+   * accepting any, and returns the energy increases of the uphill ones.
+   */
+  template <class Cost, class... Moves>
+  std::vector<double> SampleUphill(Cost&& cost_estimator,
+                                   MoveSet<Moves...> moves, int samples) {
+    const double E = cost_estimator(*this);
+    std::vector<double> uphill;
+    for (int it = 0; it < samples; ++it) {
+      Begin();
+      moves.Apply(*this, it);
+      const double Ep = cost_estimator(*this);
+      Rollback();
+      if (Ep > E) uphill.push_back(Ep - E);
+    }
+    return uphill;
+  }
+
+  /**
+   * @brief Parallel tempering. Runs `num_replicas` copies of the current
+   * mapping, one per thread, each at a fixed temperature of a geometric
+   * ladder from `min_temperature` (> 0) to `max_temperature`. Every
+   * `swap_interval` iterations neighbouring temperatures exchange their
+   * configurations with the usual Metropolis criterion. The best mapping of
+   * any replica goes to the output path, like in Run().
+   *
+   * Replicas draw from independent streams of rng(), so a run is
+   * reproducible from set_seed(). Afterwards this mapper holds the lowest
+   * energy mapping seen by any replica.
+   *
+   * @param iterations iterations per replica, unless set_time_budget()
+   * @return lowest energy seen
+   */
+  double RunParallelTempering(CostEstimator cost_estimator,
+                              std::vector<Transition> transitions,
+                              double min_temperature, double max_temperature,
+                              int iterations, int num_replicas,
+                              int swap_interval = 100);
+
+  /**
+   * @brief Stops Run() and RunParallelTempering() early once the lowest
+   * energy seen is at most `target_cost`. Both also stop early, flushing the
+   * best mapping, when TerminationRequested().
+   */
+  void set_target_cost(double target_cost) { target_cost_ = target_cost; }
+
+  /**
+   * @brief Minimum seconds between two writes of the best mapping to the
+   * output path (1 by default). Writes happen on a background thread.
    */
-  void Run(TemperatureSchedule temperature_schedule,
-           CostEstimator cost_estimator, std::vector<Transition> transitions,
-           double initial_temperature, int iterations, int runs = 1);
+  void set_write_interval(double seconds) { write_interval_ = seconds; }
+
+  /**
+   * @brief Where Run() writes the best mapping, an empty path turns writing
+   * off.
+   */
+  void set_output_path(const std::filesystem::path& output_path) {
+    output_path_ = output_path;
+  }
+
+  /**
+   * @brief Deadline mode: with `seconds` > 0, Run() anneals for `seconds`
+   * of wall time (split evenly between its runs) instead of `iterations`
+   * iterations. Elapsed time is mapped onto the schedule, which sees
+   * iterations in [0, `iterations`) as before. Runs stop early enough for
+   * the best mapping to be written before the deadline, or once
+   * `iterations` moves in a row left the cost unchanged: the moves have
+   * nothing left to change then, and an adaptive schedule would never cool.
+   * RunParallelTempering() runs until the deadline as well.
+   * 0 (the default) turns it off.
+   */
+  void set_time_budget(double seconds) { time_budget_ = seconds; }
+
+  /**
+   * @brief Writes Telemetry of Run() to `file` (JSON lines), a line every
+   * `interval` seconds. An empty path (the default) turns it off. Copies of
+   * this mapper share the file, so don't run them concurrently with
+   * telemetry on.
+   */
+  void set_telemetry(const std::filesystem::path& file, double interval = 1) {
+    telemetry_ = file.empty() ? nullptr
+                              : std::make_shared<Telemetry>(file, interval);
+  }
+
+  /**
+   * @brief Makes Run() checkpoint the mapping, RNG, schedule and loop state
+   * to `file` every `interval` seconds, when stopped by a signal and when it
+   * returns. The file is replaced atomically. An empty path (the default)
+   * turns it off. RunParallelTempering() is not checkpointed.
+   */
+  void set_checkpoint(const std::filesystem::path& file,
+                      double interval = 60) {
+    checkpoint_path_ = file;
+    checkpoint_interval_ = interval;
+  }
+
+  /**
+   * @brief Resumes from a checkpoint. The program must make the same calls
+   * as the one that wrote it, on the same design: Run() calls that had
+   * returned by the checkpoint return its lowest energy right away, the one
+   * it was taken in continues from the saved iteration with the saved
+   * mapping, RNG and schedule state (for schedules with a Serialize
+   * member), and later calls run as usual. Restores the mapping right away.
+   * Call after Initialize().
+   *
+   * @return false if the file is missing or doesn't fit, the mapping needs
+   * Initialize() again then
+   */
+  bool Resume(const std::filesystem::path& file);
 
  protected:
   /**
@@ -49,11 +281,271 @@ class SimulatedAnnealingMapper : public IterativeTechnologyMapper {
    * @param T temperature
    * @return double probability to accept state in [0.0, 1.0]
    */
-  double AcceptProbability(double E, double Ep, double T);
+  double AcceptProbability(double E, double Ep, double T) {
+    if (Ep < E) return 1;
+    return std::exp(-(Ep - E) / T);
+  }
 
  private:
-  std::filesystem::path output_path_;  // where the output netlist goes
+  /**
+   * @brief The SA loop behind both Run() overloads. `step(it)` applies the
+   * move of iteration `it` and returns its index.
+   */
+  template <class Schedule, class Cost, class Step>
+  double Anneal(Schedule& temperature_schedule, Cost& cost_estimator,
+                Step step, double initial_temperature, int iterations,
+                int runs);
+
+  /**
+   * @brief Where an Anneal() call was at a checkpoint.
+   */
+  struct AnnealPoint {
+    int call = 0;           // index of the Anneal() call on this mapper
+    bool finished = false;  // whether it had returned
+    int run = 0;            // next iteration: `it` of run `run`
+    long long it = 0;
+    double E_low = 0;
+    double elapsed = 0;    // seconds spent in the call
+    std::string schedule;  // schedule state, if it is serializable
+    Random rng;            // not in the file, it is in the mapper state
+  };
+
+  static constexpr int kClockStride = 1024;  // iterations between clock reads
+  static constexpr uint32_t kCheckpointVersion = 2;
+
+  bool SaveCheckpoint(const AnnealPoint& point) const;
+
+  std::filesystem::path output_path_;  // where the output netlist goes, if set
   std::ostream& os_;                   // where to write debug info to
+  double target_cost_ = -std::numeric_limits<double>::infinity();
+  double write_interval_ = 1;
+  double time_budget_ = 0;  // seconds, 0 for iteration based runs
+  std::shared_ptr<Telemetry> telemetry_;  // null when off
+  std::filesystem::path checkpoint_path_;  // empty when off
+  double checkpoint_interval_ = 60;
+  int anneal_calls_ = 0;               // Anneal() calls so far, or since Resume()
+  std::optional<AnnealPoint> resume_;  // checkpoint to resume at
 };
 
+template <class Schedule, class Cost, class Step>
+double SimulatedAnnealingMapper::Anneal(Schedule& temperature_schedule,
+                                        Cost& cost_estimator, Step step,
+                                        double initial_temperature,
+                                        int iterations, int runs) {
+  double E = cost_estimator(*this);  // current energy
+  double Ep;                         // E' (E prime) -- energy in updated state
+  double E_low = E;                  // lowest energy
+  double T = initial_temperature;    // temperature
+
+  // a stopped program may still make calls, they must not overwrite the
+  // checkpoint of the stop
+  if (TerminationRequested()) return E;
+
+  // resuming: skip the calls before the checkpoint, pick up the one it was
+  // taken in
+  const int call = anneal_calls_++;
+  int first_run = 0;
+  long long first_it = 0;
+  bool resumed = false;  // the schedule state of the first run is restored
+  double elapsed = 0;  // seconds spent in this call before the checkpoint
+  if (resume_) {
+    if (resume_->call > call) return resume_->E_low;
+    set_rng(resume_->rng);
+    E_low = resume_->E_low;
+    if (resume_->finished) {
+      resume_.reset();
+      return E_low;
+    }
+    if constexpr (IsSerializable<Schedule>::value) {
+      BinaryReader ar(resume_->schedule.data(), resume_->schedule.size());
+      temperature_schedule.Serialize(ar);
+    }
+    resumed = true;
+    first_run = resume_->run;
+    first_it = resume_->it;
+    elapsed = resume_->elapsed;
+    resume_.reset();
+  }
+
+  time_t last_update = time(NULL);
+
+  // the lowest energy mapping is captured lazily: when it is about to be
+  // left, when the writer is due, or at the end
+  std::optional<MappingWriter> writer;
+  if (!output_path_.empty()) {
+    writer.emplace(*this, output_path_, write_interval_);
+  }
+  bool best_saved = true;  // whether the writer has the lowest energy mapping
+
+  // the call ends on the lowest energy mapping, not where the last run
+  // stopped, so it is also encoded when it is left (before a resume, only
+  // the output file has it)
+  bool at_best = E <= E_low;  // whether the mapping is the lowest energy one
+  std::string best_mapping;   // the last one left, and its energy
+  double best_mapping_E = E;
+
+  Telemetry* const telemetry = telemetry_.get();  // null when off
+  if (telemetry) telemetry->Start(runs, iterations, initial_temperature);
+  const auto submit = [&] {
+    if (!telemetry) return writer->Submit(*this);
+    const Telemetry::Clock::time_point t0 = Telemetry::Clock::now();
+    writer->Submit(*this);
+    telemetry->AddWriteTime(Telemetry::Clock::now() - t0);
+  };
+
+  // in deadline mode, stop early enough for the final flush, which may wait
+  // for a write in progress
+  const Deadline::Clock::time_point start =
+      Deadline::Clock::now() - Deadline::Duration(elapsed);
+  const auto at = [&start](double seconds) {
+    return start + Deadline::Duration(seconds);
+  };
+  const auto reserve = [&writer] {
+    return writer ? 2 * writer->write_seconds() : 0;
+  };
+
+  // the output file gets the best mapping before each checkpoint, so that
+  // a resumed run never reports a best it doesn't have
+  const bool checkpointing = !checkpoint_path_.empty();
+  Deadline::Clock::time_point next_checkpoint =
+      Deadline::Clock::now() + Deadline::Duration(checkpoint_interval_);
+  const auto checkpoint = [&](bool finished, int run, long long next_it) {
+    if (!best_saved) {
+      submit();
+      best_saved = true;
+    }
+    AnnealPoint point;
+    point.call = call;
+    point.finished = finished;
+    point.run = run;
+    point.it = next_it;
+    point.E_low = E_low;
+    point.elapsed = std::chrono::duration<double>(Deadline::Clock::now() -
+                                                  start)
+                        .count();
+    if constexpr (IsSerializable<Schedule>::value) {
+      BinaryWriter ar;
+      temperature_schedule.Serialize(ar);
+      point.schedule = ar.buffer();
+    }
+    if (!SaveCheckpoint(point)) {
+      os_ << "[checkpoint] failed to write " << checkpoint_path_ << std::endl;
+    }
+  };
+
+  int tn = first_run;
+  long long it = 0;
+  for (; tn < runs && E_low > target_cost_; ++tn) {
+    E = cost_estimator(*this);
+    if constexpr (IsAdaptiveSchedule<Schedule>::value) {
+      if (!resumed || tn != first_run) {
+        temperature_schedule.Restart(initial_temperature);
+      }
+    }
+    std::optional<Deadline> deadline;
+    if (time_budget_ > 0) {
+      deadline.emplace(at(time_budget_ * tn / runs),
+                       at(time_budget_ * (tn + 1) / runs), iterations,
+                       reserve);
+    }
+    long long idle = 0;  // moves in a row that left the cost unchanged
+    for (it = tn == first_run ? first_it : 0;
+         (deadline ? deadline->Tick(it) && idle < iterations
+                   : it < iterations) &&
+         E_low > target_cost_ && !TerminationRequested();
+         ++it) {
+      if (checkpointing && it % kClockStride == 0 &&
+          Deadline::Clock::now() >= next_checkpoint) {
+        checkpoint(false, tn, it);
+        next_checkpoint =
+            Deadline::Clock::now() + Deadline::Duration(checkpoint_interval_);
+      }
+      T = temperature_schedule(initial_temperature,
+                               deadline ? deadline->scheduled(it) : (int)it);
+
+      // progress display BEGIN_SECTION
+      if (it % 1000 == 0) {
+        os_ << std::fixed << "epoch=" << std::setw(5) << tn
+            << " iter=" << std::setw(10) << it << " T=" << std::setw(10)
+            << std::setprecision(7) << T << std::scientific
+            << " curr = " << std::setw(10) << E << " best = " << std::setw(10)
+            << E_low << std::endl;
+        time_t current_time = time(NULL);
+        if (it && current_time <= last_update + 10) {
+          os_ << "\u001b[1F\u001b[1K";
+        } else {
+          last_update = current_time;
+        }
+      }
+      // progress display END_SECTION
+
+      // apply change
+      int move;
+      Begin();
+      if (telemetry && Telemetry::Timed(it)) {
+        const Telemetry::Clock::time_point t0 = Telemetry::Clock::now();
+        move = step(it);
+        const Telemetry::Clock::time_point t1 = Telemetry::Clock::now();
+        Ep = cost_estimator(*this);
+        telemetry->AddMoveTime(t1 - t0);
+        telemetry->AddCostTime(Telemetry::Clock::now() - t1);
+      } else {
+        move = step(it);
+        Ep = cost_estimator(*this);  // compute new temperature
+      }
+      idle = Ep == E ? idle + 1 : 0;
+      const bool accept = rng().UniformReal() < AcceptProbability(E, Ep, T);
+      if constexpr (IsAdaptiveSchedule<Schedule>::value) {
+        if (Ep > E) temperature_schedule.Observe(accept);
+      }
+      if (telemetry) telemetry->Record(move, Ep - E, accept, accept && Ep < E);
+      if (accept) {
+        if (Ep >= E_low && !best_saved) {
+          submit();  // leaving the best, captures it pre-Commit
+          best_saved = true;
+        }
+        if (at_best && Ep > E) {  // same, for ending on it
+          BinaryWriter ar;
+          EncodeMapping(ar);
+          best_mapping = ar.buffer();
+          best_mapping_E = E;
+          at_best = false;
+        }
+        Commit();
+        E = Ep;
+        if (E < E_low) {  // best seen so far?
+          E_low = E;
+          at_best = true;
+          best_saved = !writer;
+          if (writer && writer->due()) {
+            submit();
+            best_saved = true;
+          }
+        }
+      } else {
+        // undo change
+        Rollback();
+      }
+      if (telemetry) telemetry->Tick(tn, it, T, E, E_low);
+    }
+    if (TerminationRequested()) {
+      if (checkpointing) checkpoint(false, tn, it);
+      break;
+    }
+  }
+
+  if (!best_saved) submit();  // still at the best
+  if (!at_best && !best_mapping.empty() && best_mapping_E < E) {
+    BinaryReader ar(best_mapping.data(), best_mapping.size());
+    const bool decoded = DecodeMapping(ar);
+    assert(decoded && "A mapping of this design decodes.");
+    (void)decoded;
+    E = best_mapping_E;
+  }
+  if (checkpointing && !TerminationRequested()) checkpoint(true, tn, 0);
+  if (telemetry) telemetry->Finish(std::min(tn, runs - 1), it, T, E, E_low);
+  os_ << std::endl;
+  return E_low;
+}
+
 #endif  // SRC_SIMULATED_ANNEALING_MAPPER_HH_
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "socket.hh"
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+Clock::time_point Deadline(double timeout) {
+  return Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                            std::chrono::duration<double>(timeout));
+}
+
+/**
+ * @brief Waits until `fd` is readable (or, listening, has a connection).
+ *
+ * @return false if `deadline` passed first, true right away without one
+ */
+bool WaitReadable(int fd, bool has_deadline, Clock::time_point deadline) {
+  while (has_deadline) {
+    const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - Clock::now());
+    pollfd p{fd, POLLIN, 0};
+    const long long ms = std::clamp<long long>(left.count(), 0, INT_MAX);
+    const int n = poll(&p, 1, (int)ms);
+    if (n > 0) return true;
+    if (n == 0 || errno != EINTR) return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Splits "unix:PATH" or "tcp:HOST:PORT" and resolves it. Calls
+ * `use(family, addr, addr_len)` for each candidate address until it returns
+ * a descriptor >= 0.
+ */
+template <class F>
+int WithAddress(const std::string& address, F use) {
+  if (address.rfind("unix:", 0) == 0) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    const std::string path = address.substr(5);
+    if (path.size() >= sizeof(addr.sun_path)) return -1;
+    std::strcpy(addr.sun_path, path.c_str());
+    return use(AF_UNIX, (const sockaddr*)&addr, (socklen_t)sizeof(addr));
+  }
+  if (address.rfind("tcp:", 0) == 0) {
+    const size_t colon = address.rfind(':');
+    const std::string host = address.substr(4, colon - 4);
+    const std::string port = address.substr(colon + 1);
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* list = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(),
+                    &hints, &list) != 0) {
+      return -1;
+    }
+    int fd = -1;
+    for (addrinfo* ai = list; ai && fd < 0; ai = ai->ai_next) {
+      fd = use(ai->ai_family, ai->ai_addr, ai->ai_addrlen);
+    }
+    freeaddrinfo(list);
+    return fd;
+  }
+  return -1;
+}
+
+}  // namespace
+
+bool WriteAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    const ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool ReadAll(int fd, char* data, size_t size, double timeout) {
+  const auto deadline = Deadline(std::max(timeout, 0.0));
+  while (size > 0) {
+    if (!WaitReadable(fd, timeout >= 0, deadline)) return false;
+    const ssize_t n = read(fd, data, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+int ListenSocket(const std::string& address) {
+  if (address.rfind("unix:", 0) == 0) unlink(address.substr(5).c_str());
+  return WithAddress(address, [](int family, const sockaddr* addr,
+                                 socklen_t addr_len) {
+    const int fd = socket(family, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    const int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    if (bind(fd, addr, addr_len) != 0 || listen(fd, SOMAXCONN) != 0) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  });
+}
+
+int AcceptSocket(int listen_fd, double timeout) {
+  const auto deadline = Deadline(std::max(timeout, 0.0));
+  while (true) {
+    if (!WaitReadable(listen_fd, timeout >= 0, deadline)) return -1;
+    const int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd >= 0 || errno != EINTR) return fd;
+  }
+}
+
+int ConnectSocket(const std::string& address, double timeout) {
+  const auto give_up = Deadline(timeout);
+  while (true) {
+    const int fd = WithAddress(address, [](int family, const sockaddr* addr,
+                                           socklen_t addr_len) {
+      const int fd = socket(family, SOCK_STREAM, 0);
+      if (fd < 0) return -1;
+      if (connect(fd, addr, addr_len) != 0) {
+        close(fd);
+        return -1;
+      }
+      return fd;
+    });
+    if (fd >= 0 || Clock::now() >= give_up) {
+      return fd;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+}
@@ -0,0 +1,52 @@
+/**
+ * @file socket.hh
+ * @brief Stream sockets by address: "unix:PATH" or "tcp:HOST:PORT".
+ */
+
+#ifndef SRC_SOCKET_HH_
+#define SRC_SOCKET_HH_
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Listening socket for `address`, a stale unix socket file is
+ * replaced.
+ *
+ * @return file descriptor, -1 on error
+ */
+int ListenSocket(const std::string& address);
+
+/**
+ * @brief Connects to `address`, retrying for up to `timeout` seconds while
+ * nothing listens there yet.
+ *
+ * @return file descriptor, -1 on error
+ */
+int ConnectSocket(const std::string& address, double timeout = 10);
+
+/**
+ * @brief Writes all of `data`, retrying on interrupts. Doesn't raise
+ * SIGPIPE.
+ *
+ * @return false if the peer is gone
+ */
+bool WriteAll(int fd, const char* data, size_t size);
+
+/**
+ * @brief Reads exactly `size` bytes, retrying on interrupts.
+ *
+ * @param timeout seconds to wait for all of them, forever if negative
+ * @return false if the peer is gone or the time is up before that
+ */
+bool ReadAll(int fd, char* data, size_t size, double timeout = -1);
+
+/**
+ * @brief Accepts a connection on `listen_fd`, retrying on interrupts.
+ *
+ * @param timeout seconds to wait, forever if negative
+ * @return file descriptor, -1 on error or if nobody connected in time
+ */
+int AcceptSocket(int listen_fd, double timeout = -1);
+
+#endif  // SRC_SOCKET_HH_
@@ -0,0 +1,69 @@
+#include "telemetry.hh"
+
+#include <iomanip>
+
+namespace {
+
+double Seconds(std::chrono::steady_clock::duration d) {
+  return std::chrono::duration<double>(d).count();
+}
+
+}  // namespace
+
+Telemetry::Telemetry(const std::filesystem::path& file, double interval)
+    : out_(file),
+      interval_(std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double>(interval))) {
+  out_ << std::setprecision(6);
+}
+
+void Telemetry::Start(int runs, int iterations, double initial_temperature) {
+  Reset();
+  start_ = last_emit_ = Clock::now();
+  out_ << "{\"event\":\"start\",\"runs\":" << runs
+       << ",\"iterations\":" << iterations
+       << ",\"T1\":" << initial_temperature << "}\n";
+}
+
+void Telemetry::Emit(int run, long long it, double T, double E, double E_low,
+                     bool force) {
+  const Clock::time_point now = Clock::now();
+  if (!force && now - last_emit_ < interval_) return;
+  const double elapsed = Seconds(now - last_emit_);
+  // counted rather than taken from `it`, which restarts with every run and
+  // doesn't start at 0 on resume
+  long long moves = 0;
+  for (const MoveCounts& counts : moves_) moves += counts.attempts;
+
+  out_ << "{\"t\":" << Seconds(now - start_) << ",\"run\":" << run
+       << ",\"it\":" << it << ",\"T\":" << T << ",\"E\":" << E
+       << ",\"E_low\":" << E_low << ",\"moves_per_s\":"
+       << (elapsed > 0 ? moves / elapsed : 0)
+       << ",\"seconds\":{\"move\":" << Seconds(move_time_) * kTimingSample
+       << ",\"cost\":" << Seconds(cost_time_) * kTimingSample
+       << ",\"write\":" << Seconds(write_time_) << "},\"moves\":[";
+  for (size_t m = 0; m < moves_.size(); ++m) {
+    out_ << (m ? "," : "") << "{\"attempts\":" << moves_[m].attempts
+         << ",\"accepts\":" << moves_[m].accepts
+         << ",\"improves\":" << moves_[m].improves << "}";
+  }
+  out_ << "],\"uphill_log2\":{";
+  bool first = true;
+  for (int bin = 0; bin < kBins; ++bin) {
+    if (!uphill_[bin]) continue;
+    out_ << (first ? "" : ",") << "\"" << bin + kMinLog2
+         << "\":" << uphill_[bin];
+    first = false;
+  }
+  out_ << "}}\n";
+  if (force) out_.flush();
+
+  Reset();
+  last_emit_ = now;
+}
+
+void Telemetry::Reset() {
+  for (MoveCounts& counts : moves_) counts = MoveCounts();
+  uphill_.fill(0);
+  move_time_ = cost_time_ = write_time_ = Clock::duration::zero();
+}
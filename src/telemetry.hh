@@ -0,0 +1,122 @@
+/**
+ * @file telemetry.hh
+ * @brief Structured SA telemetry, written as JSON lines.
+ */
+
+#ifndef SRC_TELEMETRY_HH_
+#define SRC_TELEMETRY_HH_
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+/**
+ * @brief Counters and timings of an SA run, emitted every `interval` seconds
+ * as one JSON object per line:
+```json
+{"t":1.002,"run":0,"it":1048576,"T":0.25,"E":1402.5,"E_low":1398.1,
+ "moves_per_s":1.04e+06,"seconds":{"move":0.31,"cost":0.12,"write":0.002},
+ "moves":[{"attempts":524288,"accepts":3017,"improves":1411},...],
+ "uphill_log2":{"-4":12,"-3":30,"0":7}}
+```
+ * Counts and seconds are for the interval since the previous line, so each
+ * line describes one stretch of the schedule at about temperature `T`;
+ * `moves_per_s` is the number of moves recorded in it per second.
+ * `moves` is indexed like the moves of the run. `uphill_log2` is a histogram
+ * of uphill cost deltas by floor(log2(delta)). `move` and `cost` seconds are
+ * estimated from timing one iteration in kTimingSample. A line with
+ * `"event":"start"` marks the start of each Run().
+ *
+ * SimulatedAnnealingMapper calls it only when telemetry is on, so that off
+ * costs a null check per iteration.
+ */
+class Telemetry {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  static constexpr int kTimingSample = 64;  // time 1 in this many iterations
+  static constexpr int kClockStride = 1024;  // iterations between clock reads
+
+  /**
+   * @param file destination, truncated
+   * @param interval seconds between two lines
+   */
+  Telemetry(const std::filesystem::path& file, double interval);
+
+  /**
+   * @brief Starts a Run(): resets the counters and writes a start line.
+   */
+  void Start(int runs, int iterations, double initial_temperature);
+
+  /**
+   * @brief Whether to time iteration `it`.
+   */
+  static bool Timed(long long it) { return it % kTimingSample == 0; }
+
+  void AddMoveTime(Clock::duration d) { move_time_ += d; }
+  void AddCostTime(Clock::duration d) { cost_time_ += d; }
+  void AddWriteTime(Clock::duration d) { write_time_ += d; }
+
+  /**
+   * @brief Counts the outcome of one move, `delta` being the cost change it
+   * proposed.
+   */
+  void Record(int move, double delta, bool accepted, bool improved) {
+    if (move >= (int)moves_.size()) moves_.resize(move + 1);
+    MoveCounts& counts = moves_[move];
+    ++counts.attempts;
+    counts.accepts += accepted;
+    counts.improves += improved;
+    if (delta > 0) {
+      const int exponent = std::ilogb(delta);
+      ++uphill_[exponent < kMinLog2              ? 0
+                : exponent >= kMinLog2 + kBins ? kBins - 1
+                                               : exponent - kMinLog2];
+    }
+  }
+
+  /**
+   * @brief Writes a line if `interval` has passed. Reads the clock only
+   * every kClockStride iterations.
+   */
+  void Tick(int run, long long it, double T, double E, double E_low) {
+    if (it % kClockStride == 0) Emit(run, it, T, E, E_low, false);
+  }
+
+  /**
+   * @brief Writes a line for the end of a Run().
+   */
+  void Finish(int run, long long it, double T, double E, double E_low) {
+    Emit(run, it, T, E, E_low, true);
+  }
+
+ private:
+  struct MoveCounts {
+    long long attempts = 0;
+    long long accepts = 0;
+    long long improves = 0;
+  };
+
+  static constexpr int kMinLog2 = -32;  // smaller deltas go to the first bin
+  static constexpr int kBins = 64;
+
+  void Emit(int run, long long it, double T, double E, double E_low,
+            bool force);
+  void Reset();
+
+  std::ofstream out_;
+  const Clock::duration interval_;
+  Clock::time_point start_;
+  Clock::time_point last_emit_;
+
+  std::vector<MoveCounts> moves_;
+  std::array<long long, kBins> uphill_{};
+  Clock::duration move_time_{};
+  Clock::duration cost_time_{};
+  Clock::duration write_time_{};
+};
+
+#endif  // SRC_TELEMETRY_HH_
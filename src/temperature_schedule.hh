@@ -0,0 +1,174 @@
+/**
+ * @file temperature_schedule.hh
+ * @brief Self-calibrating SA temperature schedule: the initial temperature
+ * comes from uphill deltas sampled during a warm-up, and the cooling rate
+ * follows the measured acceptance rate (Lam-style).
+ */
+
+#ifndef SRC_TEMPERATURE_SCHEDULE_HH_
+#define SRC_TEMPERATURE_SCHEDULE_HH_
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Temperature at which uphill moves of the sampled sizes are accepted
+ * with probability `acceptance` on average, i.e. T with
+ * mean(exp(-delta / T)) = acceptance.
+ *
+ * @param uphill positive energy deltas of sampled moves
+ * @param acceptance target acceptance ratio in (0, 1)
+ * @return initial temperature, 0 if there are no samples
+ */
+inline double InitialTemperature(const std::vector<double>& uphill,
+                                  double acceptance) {
+  if (uphill.empty()) return 0;
+  double mean = 0;
+  for (double delta : uphill) mean += delta;
+  mean /= uphill.size();
+
+  // start from the estimate for equal deltas, then refine (Ben-Ameur)
+  const double log_target = std::log(acceptance);
+  double T = -mean / log_target;
+  for (int i = 0; i < 32; ++i) {
+    double chi = 0;
+    for (double delta : uphill) chi += std::exp(-delta / T);
+    chi /= uphill.size();
+    const double next = T * std::log(chi) / log_target;
+    if (!(next > 0) || std::abs(next - T) <= 1e-9 * T) break;
+    T = next;
+  }
+  return T;
+}
+
+/**
+ * @brief Lam-style adaptive schedule: the temperature follows a target
+ * acceptance rate instead of a fixed formula. It is nudged down when the
+ * measured acceptance rate is above the target and up when it is below, so
+ * the run cools quickly through flat stretches and slowly where moves
+ * matter.
+ *
+ * Only uphill moves count towards the rate (downhill and neutral ones are
+ * always accepted and say nothing about the temperature), and the target
+ * decays log-linearly from the calibrated acceptance to `final_acceptance`.
+ * Lam's original curve, with a plateau at 0.44 of all moves, kept this
+ * mapper's landscape too hot for too long (see bench/schedule_bench.cc).
+ *
+ * It is a schedule for SimulatedAnnealingMapper::Run(); since it has an
+ * Observe() member, Run() reports the outcome of uphill moves to it.
+ *
+ * Usage example
+```cpp
+AdaptiveSchedule schedule(iterations);
+schedule.Calibrate(mapper.SampleUphill(cost, moves, 500));
+mapper.Run(schedule, cost, moves, 0, iterations);
+```
+ */
+class AdaptiveSchedule {
+ public:
+  /**
+   * @param iterations length of a run, progress is `it / iterations`
+   * @param final_acceptance target acceptance rate at the end of a run
+   * @param step relative temperature change per observed move
+   */
+  explicit AdaptiveSchedule(int iterations, double final_acceptance = 1e-4,
+                            double step = 1e-3)
+      : iterations_(std::max(iterations, 1)),
+        final_acceptance_(final_acceptance),
+        step_(1 - step) {}
+
+  /**
+   * @brief Sets the initial temperature so that `acceptance` of the sampled
+   * uphill deltas would be accepted, and starts the target curve there.
+   * Without it, the first temperature passed to operator() is used.
+   */
+  void Calibrate(const std::vector<double>& uphill, double acceptance = 0.3) {
+    initial_temperature_ = InitialTemperature(uphill, acceptance);
+    initial_acceptance_ = acceptance;
+  }
+
+  /**
+   * @brief Starts a run at the calibrated initial temperature, or at
+   * `initial_temperature` if not calibrated. SimulatedAnnealingMapper::Run()
+   * calls it at the start of each run.
+   */
+  void Restart(double initial_temperature) {
+    temperature_ = initial_temperature_ > 0 ? initial_temperature_
+                                            : initial_temperature;
+    acceptance_rate_ = initial_acceptance_;
+    started_ = true;
+  }
+
+  /**
+   * @brief Temperature for iteration `it`, Restart()ing on the first call.
+   * `it` may repeat, as in deadline mode.
+   */
+  double operator()(double initial_temperature, int it) {
+    if (!started_) Restart(initial_temperature);
+    target_ = TargetAcceptance((double)it / iterations_);
+    return temperature_;
+  }
+
+  /**
+   * @brief Feeds back whether an uphill move at the current temperature was
+   * accepted, and adapts the temperature for the next iteration.
+   */
+  void Observe(bool accepted) {
+    acceptance_rate_ += (accepted - acceptance_rate_) * kRateWeight;
+    if (acceptance_rate_ > target_) {
+      temperature_ *= step_;
+    } else {
+      temperature_ /= step_;
+    }
+  }
+
+  double temperature() const { return temperature_; }
+  double acceptance_rate() const { return acceptance_rate_; }
+
+  /**
+   * @brief Saves or restores the run state (not the parameters), for
+   * checkpoints. See serialization.hh.
+   */
+  template <class Archive>
+  void Serialize(Archive& ar) {
+    ar(initial_temperature_, initial_acceptance_, temperature_,
+       acceptance_rate_, target_, started_);
+  }
+
+  /**
+   * @brief Target acceptance rate of uphill moves at `progress` in [0, 1].
+   */
+  double TargetAcceptance(double progress) const {
+    return initial_acceptance_ *
+           std::pow(final_acceptance_ / initial_acceptance_, progress);
+  }
+
+ private:
+  static constexpr double kRateWeight = 1.0 / 500;  // moving average window
+
+  int iterations_;
+  double final_acceptance_;
+  double step_;
+  double initial_temperature_ = 0;
+  double initial_acceptance_ = 0.3;
+  double temperature_ = 0;
+  double acceptance_rate_ = 0.3;
+  double target_ = 0.3;
+  bool started_ = false;
+};
+
+/**
+ * @brief Whether schedule type `S` wants Observe(accepted) feedback (and
+ * Restart() calls).
+ */
+template <class S, class = void>
+struct IsAdaptiveSchedule : std::false_type {};
+template <class S>
+struct IsAdaptiveSchedule<
+    S, std::void_t<decltype(std::declval<S&>().Observe(true))>>
+    : std::true_type {};
+
+#endif  // SRC_TEMPERATURE_SCHEDULE_HH_
@@ -1,7 +1,7 @@
 /**
  * @file utils.hh
  * @author
- * @brief Utility functions (random for now)
+ * @brief Utility functions (random, spans, module names)
  * @version 0.1
  * @date 2024-07-24
  */
@@ -9,19 +9,85 @@
 #ifndef SRC_UTILS_HH_
 #define SRC_UTILS_HH_
 
-#include <random>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "random.hh"
+
+/**
+ * @brief Non-owning view of a contiguous array, a minimal std::span.
+ */
+template <class T>
+class Span {
+ public:
+  Span() {}
+  Span(T* begin, T* end) : begin_(begin), end_(end) {}
+
+  T* begin() const { return begin_; }
+  T* end() const { return end_; }
+  size_t size() const { return end_ - begin_; }
+  bool empty() const { return begin_ == end_; }
+  T& operator[](size_t i) const { return begin_[i]; }
+
+ private:
+  T* begin_ = nullptr;
+  T* end_ = nullptr;
+};
 
 /**
- * randomly pick one from an array
+ * randomly pick one from an array, using `rng`
  */
 template <class T>
-const T choice(const std::vector<T>& arr) {
-  return arr.at(std::rand() % arr.size());
+const T choice(const std::vector<T>& arr, Random& rng) {
+  return arr.at(rng.Uniform(arr.size()));
+}
+
+template <class T>
+std::remove_const_t<T> choice(Span<T> arr, Random& rng) {
+  assert(!arr.empty() && "Nothing to choose from.");
+  return arr[rng.Uniform(arr.size())];
 }
 
 template <class T>
-const T* choice_ptr(const std::vector<T>& arr) {
-  return &arr.at(std::rand() % arr.size());
+const T* choice_ptr(const std::vector<T>& arr, Random& rng) {
+  return &arr.at(rng.Uniform(arr.size()));
+}
+
+/**
+ * Applies the -1234567 transformation to a string of
+ * underscore-delimited (_), skipping the first `skip` items.
+ * Then interprets the transformed `uint32_t*` as `char*`.
+ * Stops at the first item that is not a number.
+ *
+ * @param s input string, e.g. a top module name
+ * @param skip number of entries to skip, typically 1
+ *        for the module name
+ * @return decoded string -- should be in the format %d_%d_%d
+ */
+inline std::string DecodeModuleName(const std::string& s, int skip) {
+  std::istringstream in(s);
+  int32_t mem[0x20] = {};
+  std::string segment;
+
+  int i = 0;
+  while (i + 1 < 0x20 && std::getline(in, segment, '_')) {
+    if (skip) {
+      --skip;
+      continue;
+    }
+    char* end = nullptr;
+    long x = std::strtol(segment.c_str(), &end, 10);
+    if (segment.empty() || *end) break;
+    mem[i++] = (int32_t)(x - 1234567);
+  }
+
+  return std::string((char*)mem);
 }
 
 #endif  // SRC_UTILS_HH_